@@ -1,6 +1,8 @@
 #include "alarmtime.h"
 #include "common.h"
 #include "commonwin.h"
+#include "bitmapcache.h"
+#include "heapstats.h"
 #include <pebble.h>
 
 // Screen for setting alarm times
@@ -69,9 +71,9 @@ static void initialise_ui(void) {
   Layer *root_layer = NULL;
   s_window = window_create_fullscreen(&root_layer, &bounds);
   
-  s_res_img_upaction = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UPACTION2);
-  s_res_img_nextaction = gbitmap_create_with_resource(RESOURCE_ID_IMG_NEXTACTION);
-  s_res_img_downaction = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWNACTION2);
+  s_res_img_upaction = bitmap_cache_get(RESOURCE_ID_IMAGE_UPACTION2);
+  s_res_img_nextaction = bitmap_cache_get(RESOURCE_ID_IMG_NEXTACTION);
+  s_res_img_downaction = bitmap_cache_get(RESOURCE_ID_IMAGE_DOWNACTION2);
   s_res_gothic_18_bold = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
   s_res_bitham_30_black = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
   // action_layer
@@ -85,13 +87,14 @@ static void destroy_ui(void) {
   window_destroy(s_window);
   action_bar_layer_destroy(action_layer);
   layer_destroy(time_layer);
-  gbitmap_destroy(s_res_img_upaction);
-  gbitmap_destroy(s_res_img_nextaction);
-  gbitmap_destroy(s_res_img_downaction);
+  bitmap_cache_release(s_res_img_upaction);
+  bitmap_cache_release(s_res_img_nextaction);
+  bitmap_cache_release(s_res_img_downaction);
 }
 
 static void handle_window_unload(Window* window) {
   destroy_ui();
+  heap_checkpoint("alarmtime pop");
 }
 
 // Redraws the currently set alarm time
@@ -104,7 +107,7 @@ static void update_alarmtime() {
   }
   snprintf(s_minutestr, LEN_MIN, "%.2d", s_minute);
   
-  layer_mark_dirty(time_layer);
+  MARK_DIRTY(time_layer, "time");
 }
 
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -199,6 +202,7 @@ void show_alarmtime(int8_t day, uint8_t hour, uint8_t minute, AlarmTimeCallBack
   window_set_click_config_provider(s_window, click_config_provider);
   
   window_stack_push(s_window, true);
+  heap_checkpoint("alarmtime push");
 }
 
 void hide_alarmtime(void) {
@@ -0,0 +1,67 @@
+#include <pebble.h>
+#include "arena.h"
+
+// Fixed buffer that windows borrow their working buffers from when opened and give back when closed,
+// so opening and closing windows doesn't fragment the heap.
+// Allocations are taken from the top of the buffer and the space is reclaimed once everything above
+// a freed block has also been freed (windows are normally closed in the reverse order they were opened).
+// If the buffer is full, the heap is used instead.
+
+#define MAX_BLOCKS 8
+
+typedef struct ArenaBlock {
+  void *ptr;
+  uint16_t end;
+  bool in_use;
+} ArenaBlock;
+
+static uint8_t s_arena[ARENA_SIZE] __attribute__((aligned(4)));
+static ArenaBlock s_blocks[MAX_BLOCKS];
+static uint8_t s_block_count;
+static size_t s_high_water;
+
+// Allocates memory from the arena (or the heap if the arena is full)
+void* arena_alloc(size_t size) {
+  uint16_t start = s_block_count == 0 ? 0 : s_blocks[s_block_count-1].end;
+  // Keep every block 4 byte aligned
+  size_t end = start + ((size + 3) & ~3);
+  
+  if (s_block_count == MAX_BLOCKS || end > ARENA_SIZE) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Arena full, allocating %d bytes from the heap", (int)size);
+    return malloc(size);
+  }
+  
+  ArenaBlock *block = &s_blocks[s_block_count++];
+  block->ptr = &s_arena[start];
+  block->end = end;
+  block->in_use = true;
+  if (end > s_high_water) s_high_water = end;
+  return block->ptr;
+}
+
+// Frees memory allocated with arena_alloc
+void arena_free(void *ptr) {
+  if (ptr == NULL) return;
+  
+  if ((uint8_t*)ptr < s_arena || (uint8_t*)ptr >= s_arena + ARENA_SIZE) {
+    // Was allocated from the heap when the arena was full
+    free(ptr);
+    return;
+  }
+  
+  for (uint8_t i = 0; i < s_block_count; i++) {
+    if (s_blocks[i].ptr == ptr) {
+      s_blocks[i].in_use = false;
+      break;
+    }
+  }
+  
+  // Reclaim the space of all the freed blocks at the top
+  while (s_block_count > 0 && !s_blocks[s_block_count-1].in_use)
+    s_block_count--;
+}
+
+// Gets the most of the arena that has been in use at once
+size_t arena_high_water(void) {
+  return s_high_water;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <pebble.h>
+
+// Size of the buffer reserved for the transient allocations made by windows
+// (enough for the settings menu text with a message window open on top)
+#define ARENA_SIZE 1024
+
+void* arena_alloc(size_t size);
+void arena_free(void *ptr);
+size_t arena_high_water(void);
@@ -0,0 +1,127 @@
+#include <pebble.h>
+#include "bitmapcache.h"
+
+// Shared cache of bitmap resources so windows that are opened repeatedly, and share the same
+// action bar icons, don't have to load them again each time.
+// Bitmaps are reference counted, and a few unused bitmaps are kept (least recently used are
+// freed first) with fewer kept on Aplite to save memory.
+// With the draw profiling on (GENTLEWAKE_DIAGNOSTICS=draw, see wscript) the hit rate is logged on exit.
+
+#define MAX_ENTRIES 12
+
+#ifdef PBL_PLATFORM_APLITE
+#define MAX_UNUSED 2
+#else
+#define MAX_UNUSED 6
+#endif
+
+typedef struct CacheEntry {
+  uint32_t resource_id;
+  GBitmap *bitmap;
+  uint8_t refs;
+  uint16_t last_used;
+} CacheEntry;
+
+static CacheEntry s_entries[MAX_ENTRIES];
+static uint16_t s_use_count;
+#ifdef PROFILE_DRAW
+static uint16_t s_hits;
+static uint16_t s_misses;
+#endif
+
+static void free_entry(CacheEntry *entry) {
+  gbitmap_destroy(entry->bitmap);
+  entry->bitmap = NULL;
+  entry->refs = 0;
+}
+
+// Frees the least recently used bitmap that is no longer referenced (returns false if there are none)
+static bool evict_unused() {
+  CacheEntry *lru = NULL;
+  
+  for (uint8_t i = 0; i < MAX_ENTRIES; i++) {
+    if (s_entries[i].bitmap != NULL && s_entries[i].refs == 0 &&
+        (lru == NULL || s_entries[i].last_used < lru->last_used))
+      lru = &s_entries[i];
+  }
+  
+  if (lru == NULL) return false;
+  
+  free_entry(lru);
+  return true;
+}
+
+// Gets a bitmap for a resource, loading it only if it isn't already in the cache
+GBitmap* bitmap_cache_get(uint32_t resource_id) {
+  CacheEntry *free_slot = NULL;
+  
+  for (uint8_t i = 0; i < MAX_ENTRIES; i++) {
+    if (s_entries[i].bitmap == NULL) {
+      if (free_slot == NULL) free_slot = &s_entries[i];
+    } else if (s_entries[i].resource_id == resource_id) {
+#ifdef PROFILE_DRAW
+      s_hits++;
+#endif
+      s_entries[i].refs++;
+      s_entries[i].last_used = ++s_use_count;
+      return s_entries[i].bitmap;
+    }
+  }
+  
+#ifdef PROFILE_DRAW
+  s_misses++;
+#endif
+  
+  if (free_slot == NULL && evict_unused()) {
+    // Use the slot that was just freed
+    for (uint8_t i = 0; i < MAX_ENTRIES && free_slot == NULL; i++) {
+      if (s_entries[i].bitmap == NULL) free_slot = &s_entries[i];
+    }
+  }
+  
+  GBitmap *bitmap = gbitmap_create_with_resource(resource_id);
+  
+  if (free_slot != NULL && bitmap != NULL) {
+    free_slot->resource_id = resource_id;
+    free_slot->bitmap = bitmap;
+    free_slot->refs = 1;
+    free_slot->last_used = ++s_use_count;
+  }
+  
+  return bitmap;
+}
+
+// Releases a bitmap from bitmap_cache_get() (it stays loaded until there are too many unused bitmaps)
+void bitmap_cache_release(GBitmap *bitmap) {
+  if (bitmap == NULL) return;
+  
+  uint8_t unused = 0;
+  bool found = false;
+  
+  for (uint8_t i = 0; i < MAX_ENTRIES; i++) {
+    if (s_entries[i].bitmap == bitmap) {
+      found = true;
+      if (s_entries[i].refs > 0) s_entries[i].refs--;
+    }
+    if (s_entries[i].bitmap != NULL && s_entries[i].refs == 0) unused++;
+  }
+  
+  if (!found) {
+    // Bitmap wasn't cached (cache was full), so just free it
+    gbitmap_destroy(bitmap);
+    return;
+  }
+  
+  while (unused-- > MAX_UNUSED) evict_unused();
+}
+
+// Frees all unused cached bitmaps, and logs how effective the cache was when profiling
+// (bitmaps still in use are freed as they are released)
+void bitmap_cache_clear(void) {
+  while (evict_unused());
+  
+#ifdef PROFILE_DRAW
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "Bitmap cache: %d hits, %d misses (%d%% hit rate)", s_hits, s_misses,
+          (s_hits + s_misses) == 0 ? 0 : (s_hits * 100) / (s_hits + s_misses));
+#endif
+}
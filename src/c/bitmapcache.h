@@ -0,0 +1,6 @@
+#pragma once
+#include <pebble.h>
+
+GBitmap* bitmap_cache_get(uint32_t resource_id);
+void bitmap_cache_release(GBitmap *bitmap);
+void bitmap_cache_clear(void);
@@ -77,6 +77,40 @@ time_t get_UTC_offset(struct tm *t) {
 #endif 
 }
 
+// Gets the timestamp for a local time of day a number of days after the local date of 'now'
+// (unlike clock_to_timestamp this does not depend on the current time, and if the clocks change that
+//  day it gives the first time the clock reaches the time of day: the first of a repeated time, or the
+//  minute the clocks go forward for a skipped time)
+time_t local_to_timestamp(time_t now, int days, uint8_t hour, uint8_t minute) {
+  time_t offset = get_UTC_offset(localtime(&now));
+  // Local time in seconds since the epoch
+  time_t local = strip_time(now + offset) + (days * SECONDS_PER_DAY) + (hour * 60 * 60) + (minute * 60);
+  
+  // Get the UTC offsets a few hours either side, so any change of offset around the time is between them
+  time_t before = local - offset - (6 * 60 * 60);
+  time_t after = local - offset + (6 * 60 * 60);
+  time_t offset_before = get_UTC_offset(localtime(&before));
+  time_t offset_after = get_UTC_offset(localtime(&after));
+  
+  // Use the time with the earlier offset if it is valid (so the first of a repeated time)
+  time_t utc = local - offset_before;
+  if (get_UTC_offset(localtime(&utc)) == offset_before) return utc;
+  utc = local - offset_after;
+  if (get_UTC_offset(localtime(&utc)) == offset_after) return utc;
+  
+  // Else the time was skipped by the clocks going forward, so find the minute they went forward
+  time_t start = local - offset_after;
+  time_t end = local - offset_before;
+  while (end - start > 60) {
+    time_t mid = start + (((end - start) / 120) * 60);
+    if (get_UTC_offset(localtime(&mid)) == offset_after)
+      end = mid;
+    else
+      start = mid;
+  }
+  return end;
+}
+
 WeekDay ad2wd(AlarmDay alarmday) {
   switch (alarmday) {
     case A_SUNDAY:
@@ -96,4 +130,39 @@ WeekDay ad2wd(AlarmDay alarmday) {
     default:
       return TODAY;
   }
-}
\ No newline at end of file
+}
+
+// Calculates a CRC-16 (CCITT) checksum for validating persisted or received data
+uint16_t crc16(const void *data, size_t len) {
+  const uint8_t *bytes = data;
+  uint16_t crc = 0xFFFF;
+  
+  while (len--) {
+    crc ^= (uint16_t)(*bytes++) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  
+  return crc;
+}
+
+// Works out the period of each snooze, up to the snooze window
+// (dynamic snooze divides the snooze delay by the snooze number, down to a min. of 3 minutes)
+void gen_snooze_schedule(struct Settings_st *settings, SnoozeSchedule *schedule) {
+  schedule->count = 0;
+  schedule->total = 0;
+  
+  while (schedule->count < MAX_SNOOZES) {
+    uint16_t period = settings->snooze_delay * 60;
+    if (settings->dynamic_snooze) {
+      period /= (schedule->count + 1);
+      if (period < MIN_SNOOZE_SECS) period = MIN_SNOOZE_SECS;
+    }
+    
+    // Always allow at least 1 snooze
+    if (schedule->count > 0 && schedule->total + period > SNOOZE_WINDOW_SECS) break;
+    
+    schedule->periods[schedule->count++] = period;
+    schedule->total += period;
+  }
+}
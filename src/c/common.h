@@ -25,12 +25,34 @@
 #define IF_2(sdk2)
 #endif
 
+// Optional features, which can be compiled out by a build profile (see wscript) to save code space
+#ifndef FEATURE_KONAMI
+#define FEATURE_KONAMI 1
+#endif
+#ifndef FEATURE_GOOB
+#define FEATURE_GOOB 1
+#endif
+#ifndef FEATURE_EASY_LIGHT
+#define FEATURE_EASY_LIGHT 1
+#endif
+#ifndef FEATURE_APP_GLANCE
+#define FEATURE_APP_GLANCE 1
+#endif
+#ifndef FEATURE_SKIP_UNTIL
+#define FEATURE_SKIP_UNTIL 1
+#endif
+
+// Settings for compiled out features always read as off, so the code using them is dropped
+#define KONAMI_ON(settings)     (FEATURE_KONAMI && (settings).konamic_code_on)
+#define EASY_LIGHT_ON(settings) (FEATURE_EASY_LIGHT && (settings).easy_light)
+#define GOOB_MODE(settings)     (FEATURE_GOOB ? (settings).goob_mode : GM_Off)
+
 #ifdef PBL_RECT
 #undef ACTION_BAR_WIDTH
 #define ACTION_BAR_WIDTH 20
 #endif
 
-typedef void (*SettingsClosedCallBack)();
+typedef void (*SettingsClosedCallBack)(bool changed);
   
 typedef struct alarm {
     bool enabled;
@@ -73,6 +95,19 @@ struct Settings_st {
   uint8_t goob_monitor_period;
 } __attribute__((__packed__));
 
+// Auto-snoozing stops once another snooze would take the total snooze time over this
+#define SNOOZE_WINDOW_SECS (60*60)
+// Shortest snooze (dynamic snoozes shrink down to this)
+#define MIN_SNOOZE_SECS 180
+#define MAX_SNOOZES (SNOOZE_WINDOW_SECS / MIN_SNOOZE_SECS)
+
+// Every snooze for an alarm, worked out from the snooze settings
+typedef struct SnoozeSchedule {
+  uint8_t count;                 // Number of snoozes that fit in the snooze window
+  uint16_t total;                // Total snooze time in seconds
+  uint16_t periods[MAX_SNOOZES]; // Snooze period in seconds for each snooze
+} SnoozeSchedule;
+
 typedef enum AlarmDay {
   A_SUNDAY = 0,
   A_MONDAY = 1,
@@ -90,4 +125,7 @@ void gen_alarm_str(alarm *alarmtime, char *alarmstr, int slen);
 time_t strip_time(time_t timestamp);
 int64_t day_diff(time_t date1, time_t date2);
 time_t get_UTC_offset(struct tm *t);
-WeekDay ad2wd(AlarmDay alarmday);
\ No newline at end of file
+time_t local_to_timestamp(time_t now, int days, uint8_t hour, uint8_t minute);
+WeekDay ad2wd(AlarmDay alarmday);
+uint16_t crc16(const void *data, size_t len);
+void gen_snooze_schedule(struct Settings_st *settings, SnoozeSchedule *schedule);
\ No newline at end of file
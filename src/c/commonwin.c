@@ -11,6 +11,131 @@ Window* window_create_fullscreen(Layer **root_layer, GRect *bounds) {
   return win;
 }
 
+#ifdef PROFILE_DRAW
+
+#define MAX_PROFILED 12
+#define MAX_REASONS 4
+
+typedef struct DrawReason {
+  const char *reason;
+  uint16_t count;
+} DrawReason;
+
+typedef struct DrawStats {
+  const void *proc;
+  const char *name;
+  Layer *layer;
+  uint16_t count;
+  uint32_t total_ms;
+  uint16_t min_ms;
+  uint16_t max_ms;
+  const char *pending_reason;
+  DrawReason reasons[MAX_REASONS];
+  uint16_t other_reasons;
+} DrawStats;
+
+static DrawStats s_draw_stats[MAX_PROFILED];
+static uint8_t s_num_profiled;
+
+// Gets the current time in milliseconds (only useful for differences)
+static uint32_t now_ms(void) {
+  time_t secs;
+  uint16_t ms;
+  time_ms(&secs, &ms);
+  return (uint32_t)secs * 1000 + ms;
+}
+
+// Gets the stats for a draw proc, adding it if not yet seen
+static DrawStats* get_draw_stats(const void *proc, const char *name) {
+  for (uint8_t i = 0; i < s_num_profiled; i++) {
+    if (s_draw_stats[i].proc == proc) return &s_draw_stats[i];
+  }
+  if (s_num_profiled == MAX_PROFILED) return NULL;
+  
+  DrawStats *stats = &s_draw_stats[s_num_profiled++];
+  stats->proc = proc;
+  stats->name = name;
+  stats->min_ms = UINT16_MAX;
+  return stats;
+}
+
+// Adds a draw to the stats, along with the reason the layer was last marked dirty
+static void record_draw(DrawStats *stats, uint32_t elapsed) {
+  stats->count++;
+  stats->total_ms += elapsed;
+  if (elapsed < stats->min_ms) stats->min_ms = elapsed;
+  if (elapsed > stats->max_ms) stats->max_ms = elapsed;
+  
+  // Draws without a reason were requested by the system (window shown, menu scrolled, etc.)
+  const char *reason = stats->pending_reason ? stats->pending_reason : "system";
+  stats->pending_reason = NULL;
+  for (uint8_t i = 0; i < MAX_REASONS; i++) {
+    if (stats->reasons[i].reason == NULL) stats->reasons[i].reason = reason;
+    if (stats->reasons[i].reason == reason) {
+      stats->reasons[i].count++;
+      return;
+    }
+  }
+  stats->other_reasons++;
+}
+
+// Update proc for all profiled layers that times the actual update proc
+static void profiled_update_proc(Layer *layer, GContext *ctx) {
+  DrawStats *stats = *(DrawStats**)layer_get_data(layer);
+  uint32_t start = now_ms();
+  ((LayerUpdateProc)stats->proc)(layer, ctx);
+  record_draw(stats, now_ms() - start);
+}
+
+Layer* layer_create_with_proc_named(Layer *root_layer, LayerUpdateProc proc, GRect bounds, const char *name) {
+  DrawStats *stats = get_draw_stats(proc, name);
+  Layer *l;
+  if (stats != NULL) {
+    l = layer_create_with_data(bounds, sizeof(DrawStats*));
+    *(DrawStats**)layer_get_data(l) = stats;
+    stats->layer = l;
+    layer_set_update_proc(l, profiled_update_proc);
+  } else {
+    l = layer_create(bounds);
+    layer_set_update_proc(l, proc);
+  }
+  layer_add_child(root_layer, l);
+  return l;
+}
+
+void layer_mark_dirty_reason(Layer *layer, const char *reason) {
+  for (uint8_t i = 0; i < s_num_profiled; i++) {
+    if (s_draw_stats[i].layer == layer) s_draw_stats[i].pending_reason = reason;
+  }
+  layer_mark_dirty(layer);
+}
+
+uint32_t draw_profile_start(void) {
+  return now_ms();
+}
+
+void draw_profile_end(const void *proc, const char *name, uint32_t start) {
+  uint32_t elapsed = now_ms() - start;
+  DrawStats *stats = get_draw_stats(proc, name);
+  if (stats != NULL) record_draw(stats, elapsed);
+}
+
+// Logs the draw stats for all profiled layers
+void draw_profile_report(void) {
+  for (uint8_t i = 0; i < s_num_profiled; i++) {
+    DrawStats *stats = &s_draw_stats[i];
+    if (stats->count == 0) continue;
+    APP_LOG(APP_LOG_LEVEL_INFO, "%s: %d draws, min %d, avg %d, max %d ms", stats->name, stats->count, 
+            stats->min_ms, (int)(stats->total_ms / stats->count), stats->max_ms);
+    for (uint8_t j = 0; j < MAX_REASONS && stats->reasons[j].reason != NULL; j++)
+      APP_LOG(APP_LOG_LEVEL_INFO, "  %s: %d", stats->reasons[j].reason, stats->reasons[j].count);
+    if (stats->other_reasons > 0)
+      APP_LOG(APP_LOG_LEVEL_INFO, "  other: %d", stats->other_reasons);
+  }
+}
+
+#else
+
 Layer* layer_create_with_proc(Layer *root_layer, LayerUpdateProc proc, GRect bounds) {
   Layer *l = layer_create(bounds);
   layer_set_update_proc(l, proc); 
@@ -18,6 +143,8 @@ Layer* layer_create_with_proc(Layer *root_layer, LayerUpdateProc proc, GRect bou
   return l;
 }
 
+#endif
+
 ActionBarLayer* actionbar_create(Window *win, Layer *root_layer, const GRect *bounds, GBitmap *bmp_up, GBitmap *bmp_sel, GBitmap *bmp_down) {
   ActionBarLayer *actionbarlayer = action_bar_layer_create();
   action_bar_layer_add_to_window(actionbarlayer, win);
@@ -1,6 +1,32 @@
 #pragma once
 #include <pebble.h>
 
+// Optional profiling of layer drawing.
+// Built in with GENTLEWAKE_DIAGNOSTICS=draw (see wscript), it logs the draw count, min/avg/max draw
+// time and the reasons each layer was redrawn when the app exits (and the bitmap cache hit rate)
+
 Window* window_create_fullscreen(Layer **root_layer, GRect *bounds);
-Layer* layer_create_with_proc(Layer *root_layer, LayerUpdateProc proc, GRect bounds);
 ActionBarLayer* actionbar_create(Window *win, Layer *root_layer, const GRect *bounds, GBitmap *bmp_up, GBitmap *bmp_sel, GBitmap *bmp_down);
+
+#ifdef PROFILE_DRAW
+Layer* layer_create_with_proc_named(Layer *root_layer, LayerUpdateProc proc, GRect bounds, const char *name);
+void layer_mark_dirty_reason(Layer *layer, const char *reason);
+uint32_t draw_profile_start(void);
+void draw_profile_end(const void *proc, const char *name, uint32_t start);
+void draw_profile_report(void);
+
+// Name each layer after its update proc
+#define layer_create_with_proc(root_layer, proc, bounds) layer_create_with_proc_named(root_layer, proc, bounds, #proc)
+// Marks a layer dirty, recording why
+#define MARK_DIRTY(layer, reason) layer_mark_dirty_reason(layer, reason)
+// Profiles draw procs that aren't layer update procs (e.g. menu rows)
+#define DRAW_PROFILE_BEGIN() uint32_t draw_profile_start_ms = draw_profile_start()
+#define DRAW_PROFILE_END(proc) draw_profile_end(proc, #proc, draw_profile_start_ms)
+#else
+Layer* layer_create_with_proc(Layer *root_layer, LayerUpdateProc proc, GRect bounds);
+
+#define MARK_DIRTY(layer, reason) layer_mark_dirty(layer)
+#define DRAW_PROFILE_BEGIN()
+#define DRAW_PROFILE_END(proc)
+#define draw_profile_report()
+#endif
@@ -2,25 +2,34 @@
 #include "mainwin.h"
 #include "settings.h"
 #include "common.h"
+#include "commonwin.h"
 #include "konamicode.h"
 #include "skipwin.h"
 #include "msg.h"
+#include "persiststats.h"
+#include "history.h"
+#include "bitmapcache.h"
+#include "heapstats.h"
+#include "workermsg.h"
+#include "movement.h"
+#include "phoneconfig.h"
+#include "ledger.h"
+#include "trace.h"
 
 // Main program unit
   
-//#define DEBUG
-  
 #define WAKEUP_REASON_ALARM 0
 #define WAKEUP_REASON_SNOOZE 1
 #define WAKEUP_REASON_MONITOR 2
 #define WAKEUP_REASON_DSTCHECK 4
 #define WAKEUP_REASON_GOOB 5
+// Most an alarm wakeup is moved from the alarm time when another wakeup is already set for the time
+// (up to 5 retries a minute apart, see set_wakeup_delayed)
+#define ALARM_WAKEUP_MAX_SHIFT (5 * 60)
 
 #define MOVEMENT_THRESHOLD_LOW 10000
 #define MOVEMENT_THRESHOLD_MID 15000
 #define MOVEMENT_THRESHOLD_HIGH 20000
-
-#define REST_MOVEMENT 300
 #define NEXT_ALARM_NONE -1
 #define NEXT_ALARM_SNOOZE -2
 #define NEXT_ALARM_SKIPWEEK -3
@@ -48,9 +57,12 @@
 #define GOOBALARMTIME_KEY 26
 #define SETTINGS_KEY 50
 #define STATE_KEY 51
+#define RUNTIME_A_KEY 52
+#define RUNTIME_B_KEY 53
 #define SETTINGSVER_KEY 99
 
 #define SETTINGS_VER 1
+#define RUNTIME_VER 2
 
 // Accelerometer smoothing constants (Numerator and Denominator - Num. divided by Den. must be less than 1. Higher = smoother, slower. Lower = faster, less smooth)
 // #define FILTER_K_NUM 1
@@ -59,8 +71,13 @@
 static bool s_alarms_on = true;
 static alarm s_alarms[7];
 static char s_info[45];
+// Next alarm time and local day the info text was generated for (to tell when it could change)
+static time_t s_info_alarm_time;
+static time_t s_info_day;
 static WakeupId s_wakeup_id;
 static WakeupId s_wakeup_goob_id;
+static time_t s_wakeup_time;
+static uint32_t s_runtime_seq;
 static time_t s_snooze_until;
 static bool s_alarm_active;
 static bool s_goob_active;
@@ -69,19 +86,13 @@ static time_t s_skip_until;
 static uint8_t s_vibe_count;
 static time_t s_last_easylight;
 static bool s_accel_service_sub;
+static bool s_worker_monitoring;
 static int8_t s_next_alarm = -1;
 static bool s_light_shown;
-static int16_t s_last_x;
-static int16_t s_last_y;
-static int16_t s_last_z;
-static int s_movement;
+static StirringDetector s_stirring;
 static bool s_loaded;
 static bool s_dst_check_started;
-static bool s_last_arm_swing_dir;
-static uint8_t s_arm_swing_count;
-static time_t s_arm_swing_start;
-static int16_t s_x_filtered = -9999;
-static int16_t s_y_filtered = -9999;
+static ArmSwingDetector s_arm_swings;
 
 // Vibrate alarm paterns - 2nd dimension: [next vibe delay (sec), vibe segment index, vibe segment length]
 static uint8_t vibe_patterns_orig[18][3] = {{3, 0, 1}, {3, 0, 1}, {4, 0, 3}, {4, 0, 3}, {4, 0, 5}, {4, 0, 5}, 
@@ -105,6 +116,8 @@ static uint32_t vibe_segments_goob[3][5] = {{150, 150, 150, 150, 500}, {150, 150
 
 static AppTimer *s_vibe_timer = NULL;
 
+static SnoozeSchedule s_snooze_schedule;
+
 static struct Settings_st s_settings;
 
 static struct State_st {
@@ -115,11 +128,26 @@ static struct State_st {
   time_t last_reset_day;
 } __attribute__((__packed__)) s_state ;
 
+// All runtime state in a single record so it can be saved and restored together.
+// Records alternate between 2 persist slots (A/B) with a sequence number and CRC so that
+// if the app is killed during a save the previous record is still intact.
+struct Runtime_st {
+  uint8_t version;
+  uint32_t seq;
+  bool alarms_on;
+  WakeupId wakeup_id;
+  WakeupId wakeup_goob_id;
+  time_t wakeup_time;
+  time_t skip_until;
+  time_t goob_time;
+  struct State_st state;
+  uint16_t crc;
+} __attribute__((__packed__));
+
 // Calculate which daily alarm (if any) will be next
 // (Takes into account if the alarm for today was reset like when Smart Alarm is active and turned off
-//  before the alarm time)
-static int8_t get_next_alarm() {
-  time_t next_date;
+//  before the alarm time, and 'now' is passed in so the scheduling can be checked at any time)
+static int8_t get_next_alarm(time_t now) {
   int8_t next;
   
   if (!s_alarms_on) return NEXT_ALARM_NONE;
@@ -127,117 +155,88 @@ static int8_t get_next_alarm() {
   // If the one-time alarm is enabled, that must be the next alarm
   if (s_settings.one_time_alarm.enabled) return NEXT_ALARM_ONETIME;
   
-  // Get current time
-  time_t utc = time(NULL);
-  struct tm *t = localtime(&utc);
+  struct tm *t = localtime(&now);
   
-  // Save localtime details as the t struct gets stomped on by clock_to_timestamp
+  // Save the weekday as the t struct gets stomped on by local_to_timestamp
   uint8_t wday = t->tm_wday;
-  uint8_t hour = t->tm_hour;
-  uint8_t min = t->tm_min;
-  
-  // Get the 'skip until' time in UTC  
-  time_t skip_utc = s_skip_until - get_UTC_offset(t);
   
-  // If skipping more than 1 week of alarms, return a value indicating the s_skip_until time will
-  // need to be used to calculate the next alarm
-  if (day_diff(utc, skip_utc) >= 7) return NEXT_ALARM_SKIPWEEK;
+  // Get the number of days until the 'skip until' date (0 or less if not skipping)
+  int skip_days = (s_skip_until == 0) ? 0 :
+                  (s_skip_until - strip_time(now + get_UTC_offset(t))) / SECONDS_PER_DAY;
+  bool skipped = false;
   
   // Scan through alarms over the next 7 days (skipping today if we already had an alarm today)
-  for (int d = wday + (strip_time(utc) == s_state.last_reset_day ? 1 : 0); d <= (wday + 7); d++) {
+  for (int d = wday + (strip_time(now) == s_state.last_reset_day ? 1 : 0); d <= (wday + 7); d++) {
     next = d % 7;
     // Only look at alarms that are enabled and are after now
-    if (s_alarms[next].enabled && (d > wday || s_alarms[next].hour > hour || 
-                                   (s_alarms[next].hour == hour && s_alarms[next].minute > min))) {
-      if (d == wday)
-        // If alarm is today, strip time from current UTC time
-        next_date = strip_time(utc);
-      else
-        // Else get UTC midnight for the next alarm
-        next_date = strip_time(clock_to_timestamp(ad2wd(next), 0, 0));
-      
-      if (s_skip_until != 0 && day_diff(utc, next_date) >= 7)
-        // If skipping and there are 7 days between now and then, show as skipping at least a week
+    if (s_alarms[next].enabled && 
+        (d > wday || local_to_timestamp(now, 0, s_alarms[next].hour, s_alarms[next].minute) > now)) {
+      if ((d - wday) < skip_days)
+        // The alarm is before the skip date, so the next alarm is found from the skip date
+        skipped = true;
+      else if (skip_days > 0 && (d - wday) >= 7)
+        // If skipping today and the alarm is 7 days away, show as skipping at least a week
         // so that today does not get confused with today next week
         return NEXT_ALARM_SKIPWEEK;
-      else if (next_date >= strip_time(skip_utc))
-        // Else if next date is >= skip date (skip date is 0 if not skipping) we have the next alarm index
+      else
+        // Else the alarm is on or after the skip date so we have the next alarm index
         return next;
     }
   }
   
-  // No alarms set
-  return NEXT_ALARM_NONE;
+  // If alarms were skipped, return a value indicating the s_skip_until time will need to be used
+  // to calculate the next alarm, else no alarms are set
+  return skipped ? NEXT_ALARM_SKIPWEEK : NEXT_ALARM_NONE;
 }
 
-// Gets a timestamp from the alarm index
-static time_t alarm_to_timestamp(int8_t alarm) {
+// Gets a timestamp from the alarm index (as seen from 'now')
+static time_t alarm_to_timestamp(int8_t alarm, time_t now) {
   time_t alarm_time = 0;
-      
-  // Get current time
-  time_t curr_time = time(NULL);
-  struct tm *t = localtime(&curr_time);
   
-  WeekDay alarmday;
+  struct tm *t = localtime(&now);
   
   if (alarm == NEXT_ALARM_ONETIME) {
-    // Calculate whether the one-time alarm is today or tomorrow
-    if (s_settings.one_time_alarm.hour > t->tm_hour ||
-        (s_settings.one_time_alarm.hour == t->tm_hour &&
-         s_settings.one_time_alarm.minute > t->tm_min))
-      alarmday = TODAY; 
-    else
-      alarmday = ad2wd((t->tm_wday + 1) % 7); 
-    
-    // Get the time for the next alarm
-    alarm_time = clock_to_timestamp(alarmday, s_settings.one_time_alarm.hour, 
+    // The one-time alarm is today if the time is still to come, else tomorrow
+    alarm_time = local_to_timestamp(now, 0, s_settings.one_time_alarm.hour, 
                                     s_settings.one_time_alarm.minute);
-    // Strip seconds
-    alarm_time -= alarm_time % 60;
+    if (alarm_time <= now)
+      alarm_time = local_to_timestamp(now, 1, s_settings.one_time_alarm.hour, 
+                                      s_settings.one_time_alarm.minute);
     
   } else if (alarm == NEXT_ALARM_SKIPWEEK) {
     // Calculate the next alarm after the 'skip until' date
     
-    // First get skip time in UTC
-    time_t skip_utc = s_skip_until - get_UTC_offset(NULL);
+    // First get midday of the skip date in UTC (midday so it is still the skip date even if
+    // the UTC offset is different by then)
+    time_t skip_utc = s_skip_until + (12 * 60 * 60) - get_UTC_offset(t);
     
-    // Then get a time struct in the local timezone
-    struct tm *alarm_t = localtime(&skip_utc);
+    // Then get the weekday in the local timezone
+    uint8_t skip_wday = localtime(&skip_utc)->tm_wday;
     int8_t next_alarm = 0;
     // Then find the next alarm on or after the skip date
     for (int8_t d = 0; d < 7; d++) {
-      next_alarm = (alarm_t->tm_wday + d) % 7;
+      next_alarm = (skip_wday + d) % 7;
       if (s_alarms[next_alarm].enabled) {
         // Get the wakeup time in UTC
-        alarm_time = skip_utc + (d * (24 * 60 * 60)) +
-          (s_alarms[next_alarm].hour * (60 * 60)) + (s_alarms[next_alarm].minute * 60);
+        alarm_time = local_to_timestamp(skip_utc, d, s_alarms[next_alarm].hour, 
+                                        s_alarms[next_alarm].minute);
         break;
       }
     }
     
     if (alarm_time == 0) {
       // This should never happen, but we set the alarm time to something just in case
-      alarm_time = skip_utc + (7 * 60 * 60);
+      alarm_time = local_to_timestamp(skip_utc, 0, 7, 0);
     }
   } else {
-    if (alarm == t->tm_wday && (s_alarms[alarm].hour > t->tm_hour || 
-                                     (s_alarms[alarm].hour == t->tm_hour && 
-                                      s_alarms[alarm].minute > t->tm_min))) {
-      if (strip_time(curr_time) == s_state.last_reset_day)
-        // If the alarm day is the same day as today, but the alarm was also reset today, the 
-        // alarm must be for 1 week from now
-        alarmday = ad2wd(alarm);
-      else
-        // If next alarm is today, use the TODAY enum
-        alarmday = TODAY;
-    } else
-      // Else convert the day number to the WeekDay enum
-      alarmday = ad2wd(alarm);
-  
-    // Get the time for the next alarm
-    alarm_time = clock_to_timestamp(alarmday, s_alarms[alarm].hour, s_alarms[alarm].minute);
-    // Strip seconds
-    alarm_time -= alarm_time % 60;
+    // Get the time for the alarm on the next alarm day
+    int days = (alarm - t->tm_wday + 7) % 7;
+    alarm_time = local_to_timestamp(now, days, s_alarms[alarm].hour, s_alarms[alarm].minute);
+    
+    if (days == 0 && (alarm_time <= now || strip_time(now) == s_state.last_reset_day))
+      // If the alarm day is the same day as today, but the alarm time has passed or the alarm 
+      // was reset today, the alarm must be for 1 week from now
+      alarm_time = local_to_timestamp(now, 7, s_alarms[alarm].hour, s_alarms[alarm].minute);
   }
   
   return alarm_time;
@@ -250,6 +249,9 @@ static void gen_info_str(int8_t next_alarm) {
   char time_str[8];
   char timeto_str[20];
   
+  s_info_alarm_time = 0;
+  s_info_day = strip_time(time(NULL) + get_UTC_offset(NULL));
+  
   if (next_alarm == NEXT_ALARM_NONE) {
     strncpy(s_info, "NO ALARMS SET", sizeof(s_info));
   } else if (next_alarm == NEXT_ALARM_SKIPWEEK) {
@@ -293,7 +295,8 @@ static void gen_info_str(int8_t next_alarm) {
       gen_alarm_str(&s_alarms[next_alarm], time_str, sizeof(time_str));
     }
     
-    time_t time_to = alarm_to_timestamp(next_alarm) - time(NULL);
+    s_info_alarm_time = alarm_to_timestamp(next_alarm, time(NULL));
+    time_t time_to = s_info_alarm_time - time(NULL);
     
     if (time_to < (10 * 60 * 60)) {
       // Add 'In X hrs, Y mins' text
@@ -322,13 +325,15 @@ static void gen_info_str(int8_t next_alarm) {
 
 // Updates the displayed alarm time (and returns the next alarm day value)
 static int8_t update_alarm_display() {
-  int8_t next_alarm = get_next_alarm();
+  int8_t next_alarm = get_next_alarm(time(NULL));
   gen_info_str(next_alarm);
   update_info(s_info);
   return next_alarm;
 }
 
 // Shows details about a wakeup error 
+// (when the app was launched in the background the message shows on its own, and the app exits once
+//  it is closed)
 static void show_wakeup_error(WakeupId result, time_t wakeup_time, char *wakeup_type) {
   char msg[150];
           
@@ -360,35 +365,56 @@ static void show_wakeup_error(WakeupId result, time_t wakeup_time, char *wakeup_
 
 // A slightly more robust wakeup scheduler that retries on certain errors and
 // can retry for a different wakeup time offset by retry_diff up to retry_max times
-static WakeupId wakeup_schedule_robust(time_t wakeup_time, int wakeup_reason, bool missed_alert, int8_t retry_diff, uint8_t retry_max) {
+// (wakeup_time is updated with the time actually scheduled)
+static WakeupId wakeup_schedule_robust(time_t *wakeup_time, int wakeup_reason, bool missed_alert, int8_t retry_diff, uint8_t retry_max) {
   WakeupId result = 0;
   uint8_t try_count = 0;
   
-  result = wakeup_schedule(wakeup_time, wakeup_reason, missed_alert);
+  result = wakeup_schedule(*wakeup_time, wakeup_reason, missed_alert);
   
   if (result < 0) {
     // If result is negative, something went wrong, so make sure all wakeups for this app are cancelled and 
     // try again (don't cancel all for secondary alarms like GooB and DST Check)
     if (wakeup_reason != WAKEUP_REASON_GOOB && wakeup_reason != WAKEUP_REASON_DSTCHECK) wakeup_cancel_all();
     
-    result = wakeup_schedule(wakeup_time, wakeup_reason, missed_alert);
+    result = wakeup_schedule(*wakeup_time, wakeup_reason, missed_alert);
     
     if (result == E_RANGE) {
       // E_RANGE means some other app has the same wakeup time +/- 1 minute, so try to set
       // the wakeup for a time up to (retry_diff * retry_max) minutes before/after.
       while (result == E_RANGE && try_count++ < retry_max) {
-        wakeup_time += retry_diff;
+        *wakeup_time += retry_diff;
   
-        result = wakeup_schedule(wakeup_time, wakeup_reason, missed_alert);
+        result = wakeup_schedule(*wakeup_time, wakeup_reason, missed_alert);
       }
     }
   }
   
+  if (result < 0)
+    TRACE_EVENT(TL_ERROR, TC_SCHED, TE_WakeupFailed, wakeup_reason, result);
+  else
+    TRACE_EVENT(TL_INFO, TC_SCHED, TE_WakeupScheduled, wakeup_reason, *wakeup_time);
+  
   return result;
 }
 
+// Saves all runtime state in case of an exit
+// (alternates between the A and B slots so the last good record is never overwritten)
 static void save_state() {
-  persist_write_data(STATE_KEY, &s_state, sizeof(s_state));
+  struct Runtime_st runtime = {
+    .version = RUNTIME_VER,
+    .seq = ++s_runtime_seq,
+    .alarms_on = s_alarms_on,
+    .wakeup_id = s_wakeup_id,
+    .wakeup_goob_id = s_wakeup_goob_id,
+    .wakeup_time = s_wakeup_time,
+    .skip_until = s_skip_until,
+    .goob_time = s_goob_time,
+    .state = s_state
+  };
+  runtime.crc = crc16(&runtime, offsetof(struct Runtime_st, crc));
+  ledger_persist_write_data((s_runtime_seq & 1) ? RUNTIME_B_KEY : RUNTIME_A_KEY, &runtime, sizeof(runtime));
+  TRACE_EVENT(TL_DEBUG, TC_PERSIST, TE_StateSaved, s_runtime_seq, 0);
 }
 
 // Updates global Get Out Of Bed monitoring flag and alarm time and saves it in case of an exit
@@ -396,9 +422,33 @@ static void set_goob(bool monitoring, time_t goob_time) {
   s_state.goob_monitoring = monitoring;
   s_goob_time = goob_time;
   save_state();
-  persist_write_data(GOOBALARMTIME_KEY, &s_goob_time, sizeof(s_goob_time));
 }
 
+// Gets the wakeup time and reason for the next alarm (alarm_time), allowing for the Smart Alarm
+static time_t get_alarm_wakeup(time_t alarm_time, time_t curr_time, uint8_t *wakeup_reason) {
+  time_t wakeup_time = alarm_time;
+  
+  // If the smart alarm is on but not active, set the wakeup to the alarm time minus the monitor period
+  if (s_settings.smart_alarm && !s_state.monitoring) 
+    wakeup_time -= s_settings.monitor_period == 0 ? 300 : s_settings.monitor_period * 60;
+  
+  // If the alarm time is in the past (setting a smart alarm for just a few minutes ahead for example)
+  // then adjust it to be 5 seconds in the future
+  if (wakeup_time < curr_time) wakeup_time = curr_time + 5;
+  
+  *wakeup_reason = (s_settings.smart_alarm && !s_state.monitoring) ? WAKEUP_REASON_MONITOR : WAKEUP_REASON_ALARM;
+  return wakeup_time;
+}
+
+#ifdef STATE_CHECK
+// Checks the alarm state is consistent after each change (only built into the host tests, which
+// supply it, see test/host/state_sim_test.c)
+static void check_state(const char *where, bool wakeups_set);
+#define CHECK_STATE(where, wakeups_set) check_state(where, wakeups_set)
+#else
+#define CHECK_STATE(where, wakeups_set)
+#endif
+
 // Timer handler that sets the wakeup time after a short delay
 // (allows UI to refresh beforehand since this sometimes takes a second or 2 for some reason)
 static void set_wakeup_delayed(void *data) {
@@ -409,6 +459,7 @@ static void set_wakeup_delayed(void *data) {
     wakeup_cancel_all();
     s_wakeup_id = 0;
     s_wakeup_goob_id = 0;
+    s_wakeup_time = 0;
   }
   
   if (next_alarm != NEXT_ALARM_NONE) {
@@ -420,21 +471,14 @@ static void set_wakeup_delayed(void *data) {
       // if snoozing set a wakeup for the snooze period
       // (or even if the alarm is active set a snooze wakeup in case something happens during the alarm)
       
-      uint16_t snooze_period = 0;
-      
-      if (s_settings.dynamic_snooze && s_state.snooze_count > 0) {
-        // Shrink snooze time based on snooze count (down to a min. of 3 minutes)
-        snooze_period = (s_settings.snooze_delay * 60) / s_state.snooze_count;
-        if (snooze_period < 180) snooze_period = 180;
-      } else {
-        // Set normal snooze period
-        snooze_period = s_settings.snooze_delay * 60;
-      }
-      
-      s_snooze_until = curr_time + snooze_period;
+      // Look up the period for the snooze count (while ringing the count hasn't been increased yet, so
+      // the safety wakeup uses the last snooze's period, or the first before any snoozes, as before.
+      // Snoozing by hand past the snooze window keeps using the last period)
+      uint8_t snooze = s_state.snooze_count > s_snooze_schedule.count ? s_snooze_schedule.count : s_state.snooze_count;
+      s_snooze_until = curr_time + s_snooze_schedule.periods[snooze > 0 ? snooze - 1 : 0];
       
       // Set snooze if GooB After Alarm not enabled or snooze time is still before GooB time 
-      if (s_settings.goob_mode != GM_AfterAlarm || s_snooze_until < s_goob_time || s_goob_active) {
+      if (GOOB_MODE(s_settings) != GM_AfterAlarm || s_snooze_until < s_goob_time || s_goob_active) {
         // Show the snooze wakeup time
         if (s_state.snoozing) {
           if (s_goob_active)
@@ -444,17 +488,19 @@ static void set_wakeup_delayed(void *data) {
         } 
         
         // Schedule the wakeup
-        s_wakeup_id = wakeup_schedule_robust(s_snooze_until, WAKEUP_REASON_SNOOZE, true, 0, 0);
+        s_wakeup_id = wakeup_schedule_robust(&s_snooze_until, WAKEUP_REASON_SNOOZE, true, 0, 0);
         
         if (s_wakeup_id < 0) {
           // If ID is still negative, show error message
           show_wakeup_error(s_wakeup_id, s_snooze_until, "snooze");
+        } else {
+          s_wakeup_time = s_snooze_until;
         }
       }
       
       // Setup GooB wakeup after/instead of snooze if enabled for after alarm time and is still in the future
       if (s_goob_time > curr_time) {
-        s_wakeup_goob_id = wakeup_schedule_robust(s_goob_time, WAKEUP_REASON_GOOB, true, 60*((s_goob_time < curr_time + 360) ? 1 : -1), 5);
+        s_wakeup_goob_id = wakeup_schedule_robust(&s_goob_time, WAKEUP_REASON_GOOB, true, 60*((s_goob_time < curr_time + 360) ? 1 : -1), 5);
         
         if (s_wakeup_goob_id < 0)
           // If ID is still negative, show error message
@@ -466,28 +512,26 @@ static void set_wakeup_delayed(void *data) {
       // Set wakeup for next alarm
       
       // Get the time for the next alarm
-      time_t alarm_time = alarm_to_timestamp(next_alarm);
+      time_t alarm_time = alarm_to_timestamp(next_alarm, time(NULL));
       
       // If on, set Get Out Of Bed X min after alarm
-      if (s_settings.goob_mode == GM_AfterAlarm)
-        set_goob((curr_time >= alarm_time && curr_time < (alarm_time + (s_settings.goob_monitor_period * 60))), alarm_time + (s_settings.goob_monitor_period * 60));
-      
-      // If the smart alarm is on but not active, set the wakeup to the alarm time minus the monitor period
-      if (s_settings.smart_alarm && !s_state.monitoring) 
-        alarm_time -= s_settings.monitor_period == 0 ? 300 : s_settings.monitor_period * 60;
-      
-      // If the alarm time is in the past (setting a smart alarm for just a few minutes ahead for example)
-      // then adjust it to be 5 seconds in the future
-      if (alarm_time < curr_time) alarm_time = curr_time + 5;
+      // (saved with the wakeup IDs below)
+      if (GOOB_MODE(s_settings) == GM_AfterAlarm) {
+        s_goob_time = alarm_time + (s_settings.goob_monitor_period * 60);
+        s_state.goob_monitoring = (curr_time >= alarm_time && curr_time < s_goob_time);
+      }
       
-      uint8_t wakeup_reason = (s_settings.smart_alarm && !s_state.monitoring) ? WAKEUP_REASON_MONITOR : WAKEUP_REASON_ALARM;
+      uint8_t wakeup_reason;
+      alarm_time = get_alarm_wakeup(alarm_time, curr_time, &wakeup_reason);
       
       // Schedule the wakeup
-      s_wakeup_id = wakeup_schedule_robust(alarm_time, wakeup_reason, true, 60*((alarm_time < curr_time + 360) ? 1 : -1), 5);
+      s_wakeup_id = wakeup_schedule_robust(&alarm_time, wakeup_reason, true, 60*((alarm_time < curr_time + 360) ? 1 : -1), 5);
         
       if (s_wakeup_id < 0) {
           // If ID is still negative, show error message
           show_wakeup_error(s_wakeup_id, alarm_time, "next");
+      } else {
+        s_wakeup_time = alarm_time;
       }
       
       // If smart alarm monitoring, update display with actual alarm time
@@ -495,7 +539,7 @@ static void set_wakeup_delayed(void *data) {
       
       // Setup Get Out Of Bed Wakeup
       if (s_goob_time > curr_time) {
-        s_wakeup_goob_id = wakeup_schedule_robust(s_goob_time, WAKEUP_REASON_GOOB, true, 60*((s_goob_time < curr_time + 360) ? 1 : -1), 5);
+        s_wakeup_goob_id = wakeup_schedule_robust(&s_goob_time, WAKEUP_REASON_GOOB, true, 60*((s_goob_time < curr_time + 360) ? 1 : -1), 5);
         
         if (s_wakeup_goob_id < 0)
           // If ID is still negative, show error message
@@ -507,13 +551,13 @@ static void set_wakeup_delayed(void *data) {
       // If DST check is on, set a wakeup for redoing alarms in case of a daylight savings time change
       time_t check_time = clock_to_timestamp(s_settings.dst_check_day, s_settings.dst_check_hour, 0);
       check_time -= check_time % 60;
-      wakeup_schedule_robust(check_time, WAKEUP_REASON_DSTCHECK, false, 60, 10);
+      wakeup_schedule_robust(&check_time, WAKEUP_REASON_DSTCHECK, false, 60, 10);
     }
   }
   
   // Always make sure wakeup ID is saved immediately
-  persist_write_int(WAKEUPID_KEY, s_wakeup_id);
-  persist_write_int(WAKEUPGOOBID_KEY, s_wakeup_goob_id);
+  save_state();
+  CHECK_STATE("set_wakeup", true);
   
   // If app was started for a DST check, close the app now that the wakeups have been redone.
   if (s_dst_check_started)
@@ -525,7 +569,7 @@ static void set_wakeup_delayed(void *data) {
 static void set_wakeup(int8_t next_alarm) {
   s_next_alarm = next_alarm;
   // Delay actually setting the wakeup so the UI can update since it takes a second or 2 sometimes
-  app_timer_register(250, set_wakeup_delayed, NULL);
+  ledger_timer_register(250, set_wakeup_delayed, NULL);
 }
 
 // Updates global snoozing flag and saves it in case of an exit
@@ -556,14 +600,14 @@ static void set_lastresetday(time_t last_reset_day) {
 // Updates flag for skipping next alarm and saves it in case of an exit
 static void set_skipuntil(time_t skip_until) {
   s_skip_until = skip_until;
-  persist_write_data(SKIPUNTIL_KEY, &s_skip_until, sizeof(s_skip_until));
+  save_state();
 }
 
 static void save_settings(void *data) {
   // Save all settings
-  persist_write_data(ALARMS_KEY, s_alarms, sizeof(s_alarms));
-  persist_write_data(SETTINGS_KEY, &s_settings, sizeof(s_settings));
-  persist_write_int(SETTINGSVER_KEY, SETTINGS_VER);
+  ledger_persist_write_data(ALARMS_KEY, s_alarms, sizeof(s_alarms));
+  ledger_persist_write_data(SETTINGS_KEY, &s_settings, sizeof(s_settings));
+  ledger_persist_write_int(SETTINGSVER_KEY, SETTINGS_VER);
 }
 
 // Sets whether the one-time alarm is enabled and saves it in case of an exit
@@ -573,59 +617,202 @@ static void set_onetime_enabled(bool enabled) {
 }
 
 static void start_accel();
+static void start_monitoring();
+static void update_worker();
 
 // Turns off an active alarm or cancels a snooze and sets wakeup for next alarm
 static void reset_alarm() {
   int8_t next;
   
+  pstats_scenario("stop");
+  
+  // Keep the snooze count for the history before it is cleared
+  history_set_snoozes(s_state.snooze_count);
+  
+  // State is changed directly and saved once below, so a crash part way through can't leave
+  // a half-finished record
   s_alarm_active = false;
   s_goob_active = false;
-  set_snoozing(false);
-  set_monitoring(false);
-  set_snoozecount(0);
-  s_arm_swing_start = 0;
-  s_arm_swing_count = 0;
-  s_last_arm_swing_dir = -1;
+  s_state.snoozing = false;
+  s_snooze_until = 0;
+  s_state.monitoring = false;
+  s_state.snooze_count = 0;
+  arm_swing_reset(&s_arm_swings);
   
-  if (!s_state.goob_monitoring && !s_goob_active && s_settings.goob_mode == GM_AfterStop) {
+  if (!s_state.goob_monitoring && !s_goob_active && GOOB_MODE(s_settings) == GM_AfterStop) {
     time_t curr_time = time(NULL);
     // Clear any snoozes, etc.
     wakeup_cancel_all();
     s_wakeup_id = 0;
-    persist_write_int(WAKEUPID_KEY, s_wakeup_id);
-    set_goob(true, curr_time + (s_settings.goob_monitor_period * 60));
+    s_wakeup_goob_id = 0;
+    s_wakeup_time = 0;
+    s_state.goob_monitoring = true;
+    s_goob_time = curr_time + (s_settings.goob_monitor_period * 60);
     // Set GOOB wakeup
-    s_wakeup_goob_id = wakeup_schedule_robust(s_goob_time, WAKEUP_REASON_GOOB, false, 60*((s_goob_time < curr_time+300) ? 1 : -1), 5);
-    persist_write_int(WAKEUPGOOBID_KEY, s_wakeup_goob_id);
+    s_wakeup_goob_id = wakeup_schedule_robust(&s_goob_time, WAKEUP_REASON_GOOB, false, 60*((s_goob_time < curr_time+300) ? 1 : -1), 5);
+    save_state();
     if (s_wakeup_goob_id < 0)
       show_wakeup_error(s_wakeup_goob_id, s_goob_time, "Get Out Of Bed");
     else {
       show_status(s_goob_time, S_GooBMonitoring);
-      start_accel();
+      start_monitoring();
     }
+    CHECK_STATE("reset_alarm", true);
   } else {
-    set_goob(false, 0);
+    s_state.goob_monitoring = false;
+    s_goob_time = 0;
+    s_state.last_reset_day = strip_time(time(NULL));
+    save_state();
     if (s_settings.one_time_alarm.enabled) set_onetime_enabled(false);
-    set_lastresetday(time(NULL));
+    
+    // The night is over, so add it to the history, and save the night's energy counts in case the app
+    // doesn't get to exit normally
+    history_append();
+    ledger_save();
+    
+    // Nothing left to monitor
+    update_worker();
     
     // Update UI with next alarm details
     show_alarm_ui(false, false);
+    TRACE_EVENT(TL_INFO, TC_UI, TE_AlarmUI, false, false);
     next = update_alarm_display();
     
     // Set the next alarm wakeup
     set_wakeup(next);
+    CHECK_STATE("reset_alarm", false);
   }
 }
 
 // Snoozes active alarm
 static void snooze_alarm() {
+  pstats_scenario("snooze");
   set_snoozing(true);
   set_snoozecount(s_state.snooze_count + 1);
   
   // Set snooze wakeup
   set_wakeup(NEXT_ALARM_SNOOZE);
+  CHECK_STATE("snooze_alarm", false);
+}
+
+// Alarm modes, which decide what the buttons do, which movement detectors run, what the worker
+// monitors and how the watch vibrates (so the alarm/monitoring flags are only checked in one place)
+typedef enum AlarmMode {
+  AM_Idle,
+  AM_Ringing,
+  AM_GooBRinging,
+  AM_Snoozing,
+  AM_SmartMonitoring,
+  AM_GooBMonitoring,
+  AM_Max
+} AlarmMode;
+
+// Movement detectors run by the accelerometer handler
+#define AD_EASY_LIGHT 1
+#define AD_STIRRING 2
+#define AD_ARM_SWING 4
+
+typedef void (*ModeAction)(void);
+
+typedef struct VibeRamp {
+  uint8_t length;
+  uint8_t (*patterns)[3];
+  uint32_t (*segments)[5];
+} VibeRamp;
+
+#define VIBE_RAMP(patterns, segments) ((VibeRamp){ sizeof(patterns) / sizeof(patterns[0]), patterns, segments })
+
+typedef struct ModeHandlers {
+  ModeAction click[NUM_BUTTONS]; // Single click of each button (NULL does nothing)
+  ModeAction double_click;       // Double click of any button
+  ModeAction long_up;            // Long Up button press
+  uint8_t detectors;             // AD_ flags
+  WorkerMode worker_mode;        // What the worker monitors when it can
+  VibeRamp (*vibe_ramp)();       // Increasing vibrations while ringing (NULL when not ringing)
+} ModeHandlers;
+
+// Gets the current mode from the alarm and monitoring flags
+static AlarmMode get_alarm_mode() {
+  if (s_state.snoozing) return AM_Snoozing;
+  if (s_state.monitoring) return AM_SmartMonitoring;
+  if (s_goob_active) return AM_GooBRinging;
+  if (s_alarm_active) return AM_Ringing;
+  if (s_state.goob_monitoring) return AM_GooBMonitoring;
+  return AM_Idle;
+}
+
+// Whether nothing is ringing, snoozing or monitoring
+static bool alarm_idle() {
+  return get_alarm_mode() == AM_Idle;
 }
 
+// Vibrations for the alarm based on the vibration pattern setting
+static VibeRamp alarm_vibe_ramp() {
+  if (s_settings.vibe_pattern == VP_NSG || (s_settings.vibe_pattern == VP_NSG2Snooze && s_state.snooze_count >= 2))
+    // Not-So-Gentle Pattern (or after 2 snoozes)
+    return VIBE_RAMP(vibe_patterns_strong, vibe_segments_strong);
+  else
+    // Gentle pattern
+    return VIBE_RAMP(vibe_patterns_orig, vibe_segments_orig);
+}
+
+// Vibrations for the Get Out Of Bed alarm
+static VibeRamp goob_vibe_ramp() {
+  return VIBE_RAMP(vibe_patterns_goob, vibe_segments_goob);
+}
+
+static void show_stopwin();
+static void close_or_stop();
+static void toggle_alarms();
+static void open_settings();
+static void stop_alarm();
+#if FEATURE_SKIP_UNTIL
+static void open_skip();
+#else
+#define open_skip NULL
+#endif
+
+static const ModeHandlers s_mode_handlers[AM_Max] = {
+  [AM_Idle] = {
+    .click = { hide_mainwin, toggle_alarms, NULL, open_settings },
+    .long_up = open_skip,
+    .worker_mode = WM_None
+  },
+  [AM_Ringing] = {
+    .click = { snooze_alarm, snooze_alarm, snooze_alarm, snooze_alarm },
+    .double_click = stop_alarm,
+    .detectors = AD_EASY_LIGHT,
+    .worker_mode = WM_None,
+    .vibe_ramp = alarm_vibe_ramp
+  },
+  [AM_GooBRinging] = {
+    .click = { snooze_alarm, snooze_alarm, snooze_alarm, snooze_alarm },
+    .double_click = stop_alarm,
+    .detectors = AD_EASY_LIGHT,
+    .worker_mode = WM_None,
+    .vibe_ramp = goob_vibe_ramp
+  },
+  // Buttons are disabled when snoozing or monitoring so the alarm isn't accidentally stopped
+  [AM_Snoozing] = {
+    .click = { close_or_stop, show_stopwin, show_stopwin, show_stopwin },
+    .double_click = stop_alarm,
+    .detectors = AD_EASY_LIGHT | AD_ARM_SWING,
+    .worker_mode = WM_None
+  },
+  [AM_SmartMonitoring] = {
+    .click = { close_or_stop, show_stopwin, show_stopwin, show_stopwin },
+    .double_click = stop_alarm,
+    .detectors = AD_STIRRING | AD_ARM_SWING,
+    .worker_mode = WM_Smart
+  },
+  [AM_GooBMonitoring] = {
+    .click = { close_or_stop, show_stopwin, show_stopwin, show_stopwin },
+    .double_click = stop_alarm,
+    .detectors = AD_ARM_SWING,
+    .worker_mode = WM_GooB
+  }
+};
+
 static void vibe_alarm();
 
 // Timer event to start another vibrate segment
@@ -641,53 +828,21 @@ static void vibe_alarm() {
     s_vibe_timer = NULL;
   }
   
-  if ((s_alarm_active || s_goob_active) && ! s_state.snoozing) {
-    // If still active and not snoozing
-    
-    uint8_t pattern_length = 0;
-    uint8_t (*vibe_patterns)[3];
-    uint32_t (*vibe_segments)[5];
+  VibeRamp (*vibe_ramp)() = s_mode_handlers[get_alarm_mode()].vibe_ramp;
+  
+  if (vibe_ramp) {
+    // If still ringing and not snoozing
     
-    if (s_goob_active) {
-      // Get Out Of Bed pattern
-      pattern_length = (int)(sizeof(vibe_patterns_goob) / sizeof(vibe_patterns_goob[0]));
-      vibe_patterns = vibe_patterns_goob;
-      vibe_segments = vibe_segments_goob;
-    } else {
-      switch (s_settings.vibe_pattern) {
-        case VP_NSG:
-          // Not-So-Gentle Pattern
-          pattern_length = (int)(sizeof(vibe_patterns_strong) / sizeof(vibe_patterns_strong[0]));
-          vibe_patterns = vibe_patterns_strong;
-          vibe_segments = vibe_segments_strong;
-          break;
-        case VP_NSG2Snooze:
-          if (s_state.snooze_count >= 2) {
-            // Not-So-Gentle Pattern after 2 snoozes
-            pattern_length = (int)(sizeof(vibe_patterns_strong) / sizeof(vibe_patterns_strong[0]));
-            vibe_patterns = vibe_patterns_strong;
-            vibe_segments = vibe_segments_strong;
-          } else {
-            // Gentle Pattern before 2 snoozes
-            pattern_length = (int)(sizeof(vibe_patterns_orig) / sizeof(vibe_patterns_orig[0]));
-            vibe_patterns = vibe_patterns_orig;
-            vibe_segments = vibe_segments_orig;
-          }
-          break;
-        default:
-          // Gentle pattern
-          pattern_length = (int)(sizeof(vibe_patterns_orig) / sizeof(vibe_patterns_orig[0]));
-          vibe_patterns = vibe_patterns_orig;
-          vibe_segments = vibe_segments_orig;
-          break;
-      }
-    }
+    VibeRamp ramp = vibe_ramp();
+    uint8_t pattern_length = ramp.length;
+    uint8_t (*vibe_patterns)[3] = ramp.patterns;
+    uint32_t (*vibe_segments)[5] = ramp.segments;
     
     if (s_vibe_count >= pattern_length) {
       // If we've reach the end of the vibrate patterns...
       
-      if (((s_settings.dynamic_snooze ? 3 : s_settings.snooze_delay) * s_state.snooze_count) > 60)
-        // Reset alarm if snoozed for more than 1 hour
+      if (s_state.snooze_count >= s_snooze_schedule.count)
+        // Reset alarm if another snooze would go past the snooze window
         reset_alarm();
       else
         // Auto-snooze if not turned off
@@ -695,16 +850,15 @@ static void vibe_alarm() {
     } else {
       // Make increasingly long vibrate patterns for the alarm
       
-      // Setup timer event for next vibe using pattern array
-      if (s_vibe_count < pattern_length) {
-        s_vibe_timer = app_timer_register(vibe_patterns[s_vibe_count][0]*1000, handle_vibe_timer, NULL);
-      }
-      
       // Start current vibe using pattern and segment arrays
       VibePattern pat;
       pat.durations = vibe_segments[vibe_patterns[s_vibe_count][1]];
       pat.num_segments = vibe_patterns[s_vibe_count][2];
-      vibes_enqueue_custom_pattern(pat);
+      ledger_vibes_enqueue_custom_pattern(pat);
+      TRACE_EVENT(TL_INFO, TC_VIBE, TE_VibeStep, s_vibe_count, pat.num_segments);
+      
+      // Setup timer event for next vibe using pattern array
+      s_vibe_timer = ledger_timer_register(vibe_patterns[s_vibe_count][0]*1000, handle_vibe_timer, NULL);
       
       s_vibe_count++;
     }
@@ -713,8 +867,14 @@ static void vibe_alarm() {
 
 // Callback function to indicate when the settings have been closed
 // so that various items can be updated
-static void settings_update() {
+static void settings_update(bool changed) {
+  // Nothing to save or reschedule if the settings were only viewed
+  if (!changed) return;
+  
+  gen_snooze_schedule(&s_settings, &s_snooze_schedule);
+  
   if (s_loaded) {
+    pstats_scenario("settings close");
     // Reset the last reset day in case alarms were changed
     set_lastresetday(0);
     // Reset skip next too
@@ -723,7 +883,7 @@ static void settings_update() {
     update_autoclose_timeout(s_settings.autoclose_timeout);
     
     // Save settings after a delay to allow UI to update
-    app_timer_register(500, save_settings, NULL);
+    ledger_timer_register(500, save_settings, NULL);
   }
   
   // Update next alarm info
@@ -735,54 +895,49 @@ static void settings_update() {
 
 // Shows the appropriate window for stopping the alarm based on the settings
 static void show_stopwin() {
-  if (s_settings.konamic_code_on)
+  if (KONAMI_ON(s_settings))
     show_konamicode(reset_alarm);
   else
     show_msg("INSTRUCTIONS", "Hold Back button to exit app WITHOUT stopping alarm.\n\nDouble click ANY button to stop the alarm.", 10, false);
 }
 
-static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
-  if (!s_state.snoozing && !s_state.monitoring && (s_settings.goob_mode != GM_AfterStop || !s_state.goob_monitoring || s_goob_active)) {
-    // Disable Back button click when snoozing or monitoring sleep so we don't accidentally exit
-    
-    if (s_alarm_active || s_goob_active) {
-      // Any button single click snoozes when alarm active
-      snooze_alarm();
-    } else {
-      // If alarm not active, not snoozing, and not monitoring, exit app
-      hide_mainwin();
-    }
-  } else {
+// Back closes the app while the worker is monitoring for movement, else shows how to stop the alarm
+static void close_or_stop() {
+  if (s_worker_monitoring)
+    hide_mainwin();
+  else
     show_stopwin();
-  }
 }
 
-static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
-  if (!s_state.snoozing && !s_state.monitoring && (s_settings.goob_mode != GM_AfterStop || !s_state.goob_monitoring || s_goob_active)) {
-    // Disable Up button when snoozing or monitoring
-    
-    if (s_alarm_active || s_goob_active) {
-      // Any button single click snoozes when alarm active
-      snooze_alarm();
-    } else {
-      // Turn all alarms on or off
-      s_alarms_on = !s_alarms_on;
-      persist_write_bool(ALARMSON_KEY, s_alarms_on);
-      update_onoff(s_alarms_on);
-      // Reset skip
-      set_skipuntil(0);
-      // Reset one-time alarm
-      if (s_settings.one_time_alarm.enabled) set_onetime_enabled(false);
-      
-      int8_t next_alarm = update_alarm_display();
-      // Redo wakeup
-      set_wakeup(s_alarms_on ? next_alarm : NEXT_ALARM_NONE);
-    }
-  } else {
-    show_stopwin();
-  }
+// Turns all alarms on or off
+static void toggle_alarms() {
+  s_alarms_on = !s_alarms_on;
+  update_onoff(s_alarms_on);
+  // Reset skip (also saves the on/off state)
+  set_skipuntil(0);
+  // Reset one-time alarm
+  if (s_settings.one_time_alarm.enabled) set_onetime_enabled(false);
+  
+  int8_t next_alarm = update_alarm_display();
+  // Redo wakeup
+  set_wakeup(s_alarms_on ? next_alarm : NEXT_ALARM_NONE);
+}
+
+// Shows settings screen with current alarms and setings and a callback for when closed
+static void open_settings() {
+  show_settings(s_alarms, &s_settings, settings_update);
 }
 
+// Stops the alarm, or the monitoring for it (through the Konami Code if it is on)
+static void stop_alarm() {
+  if (KONAMI_ON(s_settings)) {
+    if (s_alarm_active || s_goob_active) snooze_alarm();
+    show_konamicode(reset_alarm);
+  } else
+    reset_alarm();
+}
+
+#if FEATURE_SKIP_UNTIL
 // Callback for when a 'skip until' date is set
 static void update_skip(time_t skip_until) {
   set_skipuntil(skip_until);
@@ -795,74 +950,69 @@ static void update_skip(time_t skip_until) {
   set_wakeup(next_alarm);
 }
 
-static void up_longclick_handler(ClickRecognizerRef recognizer, void *context) {
-  if (!s_alarm_active && !s_goob_active && !s_state.snoozing && !s_state.monitoring && !s_state.goob_monitoring) {
-    // Disable long Up button press when alarm active, snoozing, or monitoring
-    
-    // Show window for setting 'skip until' date
-    show_skipwin(s_skip_until, update_skip);
-  }
+// Shows window for setting 'skip until' date
+static void open_skip() {
+  show_skipwin(s_skip_until, update_skip);
 }
 
-static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
-  // Single click snoozes when alarm active, Select button single click is disabled otherwise
-  if (!s_state.snoozing && !s_state.monitoring && (s_settings.goob_mode != GM_AfterStop || !s_state.goob_monitoring || s_goob_active)) {
-    if (s_alarm_active || s_goob_active) 
-      snooze_alarm();
-  } else {
-    show_stopwin();
-  }
+static void up_longclick_handler(ClickRecognizerRef recognizer, void *context) {
+  ModeAction action = s_mode_handlers[get_alarm_mode()].long_up;
+  if (action) action();
 }
+#endif
 
-static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
-  if (!s_state.snoozing && !s_state.monitoring && (s_settings.goob_mode != GM_AfterStop || !s_state.goob_monitoring || s_goob_active)) {
-    // Disable Up button when snoozing or monitoring
-    
-    if (s_alarm_active || s_goob_active)
-      // Any button single click snoozes when alarm active
-      snooze_alarm();
-    else
-      // Show settings screen with current alarms and setings and a callback for when closed
-      show_settings(s_alarms, &s_settings, settings_update);
-  } else {
-    show_stopwin();
-  }
+static void click_handler(ClickRecognizerRef recognizer, void *context) {
+  ModeAction action = s_mode_handlers[get_alarm_mode()].click[click_recognizer_get_button_id(recognizer)];
+  if (action) action();
 }
 
 static void multiclick_handler(ClickRecognizerRef recognizer, void *context) {
-  // If alarm is active (or snoozing) or smart alarm is active, double clicking
-  // any button will reset the alarm
-  if (s_alarm_active || s_state.monitoring || s_goob_active || s_state.goob_monitoring) {
-    if (s_settings.konamic_code_on) {
-      if (s_alarm_active || s_goob_active) snooze_alarm();
-      show_konamicode(reset_alarm);
-    } else
-      reset_alarm();
-  }
+  ModeAction action = s_mode_handlers[get_alarm_mode()].double_click;
+  if (action) action();
 }
 
 // Trap single and double clicks for ALL buttons
 static void click_config_provider(void *context) {
-  window_single_click_subscribe(BUTTON_ID_BACK, back_click_handler);
-  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
-  window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
-  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+  window_single_click_subscribe(BUTTON_ID_BACK, click_handler);
+  window_single_click_subscribe(BUTTON_ID_UP, click_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, click_handler);
+  window_single_click_subscribe(BUTTON_ID_DOWN, click_handler);
   window_multi_click_subscribe(BUTTON_ID_BACK, 2, 2, 300, true, multiclick_handler);
   window_multi_click_subscribe(BUTTON_ID_UP, 2, 2, 300, true, multiclick_handler);
   window_multi_click_subscribe(BUTTON_ID_SELECT, 2, 2, 300, true, multiclick_handler);
   window_multi_click_subscribe(BUTTON_ID_DOWN, 2, 2, 300, true, multiclick_handler);
+#if FEATURE_SKIP_UNTIL
   window_long_click_subscribe(BUTTON_ID_UP, 1000, up_longclick_handler, NULL);
+#endif
 }
 
-// Start the alarm, including vibrating the Pebble
-static void start_alarm() {
-  s_alarm_active = true;
-  s_goob_active = false;
-  set_snoozing(false);
-  set_monitoring(false);
+// Starts ringing the alarm or Get Out Of Bed alarm: only the state in memory is changed before the
+// first vibration, and alarm_started or goob_alarm_started does the rest
+static void ring(bool goob) {
+  s_alarm_active = !goob;
+  s_goob_active = goob;
+  s_state.snoozing = false;
+  s_snooze_until = 0;
+  s_state.monitoring = false;
+  
+  // Start alarm vibrate
+  s_vibe_count = 0;
+  vibe_alarm();
+}
+
+// Finishes starting the alarm once it is ringing
+// (the state is saved once the snooze wakeup is set)
+static void alarm_started() {
+  // Save the movement for the last epoch of any monitoring the app was doing
+  stirring_save(&s_stirring);
   show_alarm_ui(true, false);
+  TRACE_EVENT(TL_INFO, TC_UI, TE_AlarmUI, true, false);
+  
+  history_triggered(false);
+  // Any monitoring now happens in the app
+  update_worker();
   
-  if (s_settings.goob_mode == GM_AfterAlarm) {
+  if (GOOB_MODE(s_settings) == GM_AfterAlarm) {
     // Start Get Out Of Bed monitoring if set to start after alarm start
     set_goob(true, s_goob_time == 0 || s_goob_time < time(NULL) ? time(NULL) + (s_settings.goob_monitor_period * 60) : s_goob_time);
     start_accel();
@@ -870,164 +1020,131 @@ static void start_alarm() {
   
   // Set snooze wakeup in case app is closed with the alarm vibrating
   set_wakeup(NEXT_ALARM_SNOOZE);
-  
-  // Start alarm vibrate
-  s_vibe_count = 0;
-  vibe_alarm();
+  CHECK_STATE("start_alarm", false);
 }
 
-// Start the Get Out Of Bed alarm, including vibrating the Pebble
-static void start_goob_alarm() {
-  s_alarm_active = false;
-  s_goob_active = true;
-  set_snoozing(false);
-  set_monitoring(false);
+// Finishes starting the Get Out Of Bed alarm once it is ringing
+static void goob_alarm_started() {
   show_alarm_ui(true, true);
+  TRACE_EVENT(TL_INFO, TC_UI, TE_AlarmUI, true, true);
+  
+  history_set_flag(HF_GOOB_RANG);
+  update_worker();
   // Set snooze wakeup in case app is closed with the alarm vibrating
   set_wakeup(NEXT_ALARM_SNOOZE);
+  CHECK_STATE("start_goob_alarm", false);
+}
 
-  // Start alarm vibrate
-  s_vibe_count = 0;
-  vibe_alarm();
+// Start the alarm, including vibrating the Pebble
+static void start_alarm() {
+  ring(false);
+  alarm_started();
 }
 
 // Timer event to unsubscribe the accelerometer service after a delay
 // (without the delay it could be called during the service callback, which crashes the app)
 static void unsub_accel_delay(void *data) {
-  if (s_accel_service_sub && !s_state.monitoring && !s_state.goob_monitoring && ((!s_alarm_active && !s_goob_active && !s_state.snoozing) || !s_settings.easy_light)) {
+  bool app_monitoring = (s_state.monitoring || s_state.goob_monitoring) && !s_worker_monitoring;
+  bool easy_light = (s_alarm_active || s_goob_active || s_state.snoozing) && EASY_LIGHT_ON(s_settings);
+  if (s_accel_service_sub && !app_monitoring && !easy_light) {
     accel_data_service_unsubscribe();
     s_accel_service_sub = false;
   }
 }
 
-// Handle accelerometer data while smart alarm is active or alarm is active/snoozing
-// to detect stirring or lifting watch for Easy Light respectively
-static void accel_handler(AccelData *data, uint32_t num_samples) {
-  if (s_alarm_active || s_goob_active || s_state.snoozing || s_state.monitoring || s_state.goob_monitoring) {
-    if (s_alarm_active || s_goob_active || s_state.snoozing) {
-      if (s_settings.easy_light) {
-        for (uint32_t i = 0; i < num_samples; i++) {
-          // If watch screen is held vertically (as if looking at the time) while alarm is on or snoozing,
-          // turn the light on for a few seconds
-          if (!data[i].did_vibrate) {
-            if ((data[i].x > -1250 && data[i].x < -750) || (data[i].x > 750 && data[i].x < 1250) ||
-                (data[i].y > -1250 && data[i].y < -750)) {
-              if (!s_light_shown && (data[i].timestamp - s_last_easylight) > 3000) {
-                // Record when light was last shown and has been shown in this position
-                // so it doesn't keep coming on
-                s_last_easylight = data[i].timestamp;
-                s_light_shown = true;
-                light_enable_interaction();
-                break;
-              } 
-            } else {
-              // When watch is lowered, reset this flag
-              s_light_shown = false;
-            }
-          }
-        }
-      }
-    } else if (s_state.monitoring) {
-      // Smart Alarm is active, so check for an accumultaive amount of movement, which may indicate stirring
-      
-      // Initialize last x, y, z readings
-      if (s_last_x == 0) s_last_x = data[0].x;
-      if (s_last_y == 0) s_last_y = data[0].y;
-      if (s_last_z == 0) s_last_z = data[0].z;
-      
-      int diff;
-      
-      // Get the accel difference for each direction for the last sample period and as positive values
-      // and add to the movement counter
-      for (uint32_t i = 0; i < num_samples; i++) {
-        if (!data[i].did_vibrate) {
-          diff = s_last_x - data[i].x;
-          s_movement += (diff > 0 ? diff : -diff);
-          diff = s_last_y - data[i].y;
-          s_movement += (diff > 0 ? diff : -diff);
-          diff = s_last_z - data[i].z;
-          s_movement += (diff > 0 ? diff : -diff);
-          s_last_x = data[i].x;
-          s_last_y = data[i].y;
-          s_last_z = data[i].z;
-        }
-      }
-      
-      // At rest, movement value can accumulate by about 200, so subtract X on every call so
-      // that sustained movement is required to trigger the alarm
-      s_movement -= REST_MOVEMENT;
-      
-      if (s_movement < 0)
-        // Movement counter cannot be negative
-        s_movement = 0;
-      else if ((s_settings.sensitivity == MS_LOW && s_movement > MOVEMENT_THRESHOLD_HIGH) ||
-               (s_settings.sensitivity == MS_MEDIUM && s_movement > MOVEMENT_THRESHOLD_MID) ||
-               (s_settings.sensitivity == MS_HIGH && s_movement > MOVEMENT_THRESHOLD_LOW))
-        // If movement counter is over the threshold, activate alarm
-        start_alarm();
-      
-#ifdef DEBUG
-      APP_LOG(APP_LOG_LEVEL_DEBUG, "Movement: %d", s_movement);
-#endif
-    }
-    
-    if (s_state.goob_monitoring && ((!s_alarm_active && !s_goob_active) || (s_state.snoozing && s_goob_time <= s_snooze_until))) {
-      // Monitor for movement that will cancel the Get Out Of Bed alarm
-      // (5 arm swings with no more than 2 seconds between swings will cancel alarm)
-      
-      time_t curr_time = time(NULL);
-      
-      if (curr_time - s_arm_swing_start > 2) {
-        // Reset arm swing stats if more than 2 seconds have passed since last registered swing
-#ifdef DEBUG
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "Resetting arm swing stats");
-#endif
-        s_arm_swing_start = curr_time;
-        s_arm_swing_count = 0;
-        s_last_arm_swing_dir = -1;
-        s_x_filtered = data[0].x;
-        s_y_filtered = data[0].y;
-      }
-      
-      for (uint32_t i = 0; i < num_samples; i++) {
-        if (!data[i].did_vibrate) {
-          // Perform single pass IIR filter on accelerometer values to get smoother motion
-          s_x_filtered = (s_x_filtered >> 1) + (data[i].x >> 1);
-          s_y_filtered = (s_y_filtered >> 1) + (data[i].y >> 1);
-          
-          // Very simplistic arm swing detection
-          if (s_x_filtered <= -500 || s_x_filtered >= 500) {
-            // Arm is probably somewhat vertical
-            if ((s_y_filtered >= 350 && !s_last_arm_swing_dir) ||
-                (s_y_filtered <= 350 && s_last_arm_swing_dir)) {
-              // Arm probably changing direction, so count as a swing every other time
-              s_last_arm_swing_dir ^= true;
-              if (s_last_arm_swing_dir) {
-                s_arm_swing_count++;
-#ifdef DEBUG
-                APP_LOG(APP_LOG_LEVEL_DEBUG, "Arm swing count: %d", s_arm_swing_count);
-#endif
-                // Restart idle countdown
-                s_arm_swing_start = curr_time;
-              }
-            }
-          }
-        }
-      }
-      
-#ifdef DEBUG
-      APP_LOG(APP_LOG_LEVEL_DEBUG, "GooB Monitoring - x: %d, y: %d", s_x_filtered, s_y_filtered);
-#endif
-      
-      if (s_arm_swing_count >= 5) {
-        reset_alarm();
-        vibes_short_pulse();
+// Gets the amount of movement that will trigger the Smart Alarm for the sensitivity setting
+static uint16_t get_movement_threshold() {
+  switch (s_settings.sensitivity) {
+    case MS_LOW:
+      return MOVEMENT_THRESHOLD_HIGH;
+    case MS_HIGH:
+      return MOVEMENT_THRESHOLD_LOW;
+    default:
+      return MOVEMENT_THRESHOLD_MID;
+  }
+}
+
+// Turns the light on for a few seconds when the watch is held up as if looking at the time
+// while the alarm is ringing or snoozing (Easy Light)
+static void detect_easy_light(AccelData *data, uint32_t num_samples) {
+  for (uint32_t i = 0; i < num_samples; i++) {
+    // If watch screen is held vertically (as if looking at the time) while alarm is on or snoozing,
+    // turn the light on for a few seconds
+    if (!data[i].did_vibrate) {
+      if ((data[i].x > -1250 && data[i].x < -750) || (data[i].x > 750 && data[i].x < 1250) ||
+          (data[i].y > -1250 && data[i].y < -750)) {
+        if (!s_light_shown && (data[i].timestamp - s_last_easylight) > 3000) {
+          // Record when light was last shown and has been shown in this position
+          // so it doesn't keep coming on
+          s_last_easylight = data[i].timestamp;
+          s_light_shown = true;
+          ledger_light_enable_interaction();
+          break;
+        } 
+      } else {
+        // When watch is lowered, reset this flag
+        s_light_shown = false;
       }
     }
-  } else if (s_accel_service_sub) {
+  }
+}
+
+// Checks for an accumulative amount of movement while the Smart Alarm is monitoring, which
+// may indicate stirring
+static void detect_stirring(AccelData *data, uint32_t num_samples) {
+  int movement = stirring_add(&s_stirring, data, num_samples);
+  
+  if (movement > get_movement_threshold()) {
+    // If movement counter is over the threshold, activate alarm
+    history_triggered(true);
+    start_alarm();
+  }
+  
+  TRACE_EVENT(TL_DEBUG, TC_ACCEL, TE_Movement, movement, get_movement_threshold());
+}
+
+// Monitors for movement that will cancel the Get Out Of Bed alarm
+static void detect_arm_swing(AccelData *data, uint32_t num_samples) {
+  uint8_t last_count = s_arm_swings.count;
+  uint8_t count = arm_swing_add(&s_arm_swings, data, num_samples);
+  
+  if (count < last_count)
+    TRACE_EVENT(TL_DEBUG, TC_ACCEL, TE_ArmSwingReset, 0, 0);
+  else if (count > last_count)
+    TRACE_EVENT(TL_INFO, TC_ACCEL, TE_ArmSwing, count, 0);
+  TRACE_EVENT(TL_DEBUG, TC_ACCEL, TE_GooBFiltered, s_arm_swings.x_filtered, s_arm_swings.y_filtered);
+  
+  if (count >= GOOB_ARM_SWINGS) {
+    history_set_flag(HF_GOOB_STOPPED);
+    reset_alarm();
+    ledger_vibes_short_pulse();
+  }
+}
+
+// Handle accelerometer data with the movement detectors for the current mode
+static void accel_handler(AccelData *data, uint32_t num_samples) {
+  ledger_count(LC_AccelCallbacks);
+  ledger_add(LC_AccelSamples, num_samples);
+  
+  uint8_t detectors = s_mode_handlers[get_alarm_mode()].detectors;
+  
+  if ((detectors & AD_EASY_LIGHT) && EASY_LIGHT_ON(s_settings))
+    detect_easy_light(data, num_samples);
+  
+  // The worker does the Smart Alarm and Get Out Of Bed monitoring when it is running
+  if ((detectors & AD_STIRRING) && !s_worker_monitoring)
+    detect_stirring(data, num_samples);
+  
+  // (checked after stirring is detected since that starts the alarm, and not while the alarm
+  //  is ringing or snoozing unless the Get Out Of Bed time has passed)
+  if (FEATURE_GOOB && (detectors & AD_ARM_SWING) && s_state.goob_monitoring && !s_worker_monitoring && 
+      ((!s_alarm_active && !s_goob_active) || (s_state.snoozing && s_goob_time <= s_snooze_until)))
+    detect_arm_swing(data, num_samples);
+  
+  if (detectors == 0 && s_accel_service_sub) {
     // Stop monitoring for movement if nothing is active
     // (Delayed by 250ms since Pebble doesn't like the accel service being unsubscribed during this call)
-    app_timer_register(250, unsub_accel_delay, NULL);
+    ledger_timer_register(250, unsub_accel_delay, NULL);
   }
 }
 
@@ -1040,44 +1157,200 @@ static void start_accel() {
   }
 }
 
+// Hands Smart Alarm or Get Out Of Bed monitoring to the background worker when there is nothing else
+// needing the app, or stops the worker when it isn't needed
+static void update_worker() {
+  WorkerConfig config = { .mode = s_mode_handlers[get_alarm_mode()].worker_mode, .threshold = get_movement_threshold(),
+                          .alarm_time = s_stirring.alarm_time };
+  
+  if (config.mode == WM_None) {
+    if (app_worker_is_running()) app_worker_kill();
+    s_worker_monitoring = false;
+    return;
+  }
+  
+  // Save the config for the worker to load when launched, or send it if the worker is already running
+  ledger_persist_write_data(WORKER_CONFIG_KEY, &config, sizeof(config));
+  if (app_worker_is_running()) {
+    AppWorkerMessage msg = { .data0 = 0 };
+    app_worker_send_message(WMT_Config, &msg);
+    s_worker_monitoring = true;
+  } else {
+    // (if the user is being asked to confirm replacing another app's worker, the app monitors until
+    //  the worker starts and says so)
+    AppWorkerResult result = app_worker_launch();
+    s_worker_monitoring = (result == APP_WORKER_RESULT_SUCCESS || result == APP_WORKER_RESULT_ALREADY_RUNNING);
+  }
+}
+
+// Starts monitoring for the Smart Alarm or Get Out Of Bed alarm, in the worker if possible
+// (else the app does it)
+static void start_monitoring() {
+  update_worker();
+  if (!s_worker_monitoring) start_accel();
+}
+
+// Handles an event detected by the worker
+static void handle_worker_event(uint16_t type) {
+  persist_delete(WORKER_EVENT_KEY);
+  
+  if (type == WMT_Stirring && s_state.monitoring) {
+    history_triggered(true);
+    start_alarm();
+    if (EASY_LIGHT_ON(s_settings)) start_accel();
+  } else if (type == WMT_GooBStopped && s_state.goob_monitoring && !s_alarm_active && !s_goob_active) {
+    history_set_flag(HF_GOOB_STOPPED);
+    reset_alarm();
+    ledger_vibes_short_pulse();
+  }
+}
+
+// Handler for messages from the worker
+static void worker_message_handler(uint16_t type, AppWorkerMessage *data) {
+  if (type == WMT_Monitoring) {
+    // The worker started after the user confirmed it, so hand the monitoring over to it
+    // (the config is sent again in case the mode changed while waiting)
+    if (!s_worker_monitoring) {
+      update_worker();
+      if (s_worker_monitoring) ledger_timer_register(250, unsub_accel_delay, NULL);
+    }
+  } else
+    handle_worker_event(type);
+}
+
+// Adds a wakeup to the energy ledger
+static void count_wakeup(int32_t reason) {
+  switch (reason) {
+    case WAKEUP_REASON_ALARM:
+      ledger_count(LC_WakeupAlarm);
+      break;
+    case WAKEUP_REASON_SNOOZE:
+      ledger_count(LC_WakeupSnooze);
+      break;
+    case WAKEUP_REASON_MONITOR:
+      ledger_count(LC_WakeupMonitor);
+      break;
+    case WAKEUP_REASON_DSTCHECK:
+      ledger_count(LC_WakeupDSTCheck);
+      break;
+    case WAKEUP_REASON_GOOB:
+      ledger_count(LC_WakeupGooB);
+      break;
+  }
+}
+
+// Adds the app launch to the energy ledger
+static void count_launch(AppLaunchReason reason) {
+  switch (reason) {
+    case APP_LAUNCH_USER:
+    case APP_LAUNCH_QUICK_LAUNCH:
+      ledger_count(LC_LaunchUser);
+      break;
+    case APP_LAUNCH_WAKEUP:
+      ledger_count(LC_LaunchWakeup);
+      break;
+    case APP_LAUNCH_WORKER:
+      ledger_count(LC_LaunchWorker);
+      break;
+    default:
+      ledger_count(LC_LaunchOther);
+      break;
+  }
+}
+
+// Gets the time of the alarm an alarm wakeup was set for (the wakeup itself may be a few minutes off)
+static time_t get_woken_alarm_time(time_t wakeup_time) {
+  time_t before = wakeup_time - ALARM_WAKEUP_MAX_SHIFT;
+  int8_t alarm = get_next_alarm(before);
+  
+  if (alarm != NEXT_ALARM_NONE) {
+    time_t alarm_time = alarm_to_timestamp(alarm, before);
+    if (alarm_time <= wakeup_time + ALARM_WAKEUP_MAX_SHIFT) return alarm_time;
+  }
+  return wakeup_time;
+}
+
+// Starts ringing for an alarm, snooze or Get Out Of Bed wakeup (only the state in memory is changed
+// before the first vibration, ring_wakeup_started does the rest)
+static void ring_wakeup(int32_t reason) {
+  bool goob = reason == WAKEUP_REASON_GOOB || s_goob_active || 
+              (GOOB_MODE(s_settings) != GM_Off && s_goob_time != 0 && s_goob_time < time(NULL));
+  
+  // Clear last reset day since the alarm is now active
+  // (saved along with the rest of the state when the snooze wakeup is set)
+  s_state.last_reset_day = 0;
+  // Also reset skip
+  s_skip_until = 0;
+  if (!goob && reason != WAKEUP_REASON_SNOOZE) s_state.snooze_count = 0;
+  ring(goob);
+}
+
+// Finishes starting the alarm for a wakeup once it is ringing
+static void ring_wakeup_started(int32_t reason) {
+  if (s_goob_active)
+    goob_alarm_started();
+  else {
+    // The night's record was started when Smart Alarm monitoring started, else start it now
+    time_t alarm_time = get_woken_alarm_time(s_wakeup_time);
+    if (reason == WAKEUP_REASON_ALARM && history_alarm_time() != alarm_time) history_start(alarm_time);
+    alarm_started();
+  }
+  
+  // Monitor movement for Easy Light, and for the Get Out Of Bed alarm in the worker if possible
+  if (s_state.goob_monitoring) start_monitoring();
+  if (EASY_LIGHT_ON(s_settings)) start_accel();
+}
+
+// Starts Smart Alarm monitoring for a monitor wakeup, in the worker if possible, and returns the alarm
+// it is for (the caller sets the wakeup for it)
+static int8_t start_smart_monitoring() {
+  // Clear last reset day since the smart alarm is now active (saved by set_snoozecount), and reset skip
+  s_state.last_reset_day = 0;
+  s_skip_until = 0;
+  
+  // Start monitoring activity for stirring
+  set_snoozecount(0);
+  set_monitoring(true);
+  int8_t next_alarm = get_next_alarm(time(NULL));
+  time_t alarm_time = alarm_to_timestamp(next_alarm, time(NULL));
+  history_start(alarm_time);
+  stirring_reset(&s_stirring, alarm_time);
+  start_monitoring();
+  return next_alarm;
+}
+
 // Handler for when the wakeup time occurs
 static void wakeup_handler(WakeupId id, int32_t reason) {
+  count_wakeup(reason);
+  TRACE_EVENT(TL_INFO, TC_SCHED, TE_Wakeup, reason, id);
+  
   if (reason == WAKEUP_REASON_DSTCHECK) {
+    pstats_scenario("DST check");
     // If wakeup was for Daylight Savings Time check and we're not in the middle
     // of an active alarm or monitoring (which will update the wakeup times anyway), then
     // redo the alarm wakeups
     if (!s_alarm_active && !s_state.snoozing && !s_state.monitoring)
-      set_wakeup(s_alarms_on ? get_next_alarm() : -1);
+      set_wakeup(s_alarms_on ? get_next_alarm(time(NULL)) : -1);
+  } else if (reason == WAKEUP_REASON_MONITOR) {
+    // Set wakeup for the actual alarm time in case we're dead to the world or something goes wrong during monitoring
+    set_wakeup(start_smart_monitoring());
   } else {
-    // Clear last reset day since either normal alarm or smart alarm is now active 
-    set_lastresetday(0);
-    // Also reset skip
-    set_skipuntil(0);
-  
-    if (reason == WAKEUP_REASON_MONITOR) {
-      // Start monitoring activity for stirring
-      set_snoozecount(0);
-      set_monitoring(true);
-      s_last_x = 0;
-      s_last_y = 0;
-      s_last_z = 0;
-      s_movement = 0;
-      // Set wakeup for the actual alarm time in case we're dead to the world or something goes wrong during monitoring
-      set_wakeup(get_next_alarm());
-    } else if (reason == WAKEUP_REASON_GOOB || s_goob_active || 
-               (s_settings.goob_mode != GM_Off && s_goob_time != 0 && s_goob_time < time(NULL))) {
-      start_goob_alarm();
-    } else {
-      // Activate the alarm
-      if (reason != WAKEUP_REASON_SNOOZE) set_snoozecount(0);
-      start_alarm();
-    }
-    
-    // Monitor movement for either Smart Alarm or Easy Light
-    if (s_state.monitoring || s_state.goob_monitoring || s_settings.easy_light) {
-      start_accel();
-    }
+    // Activate the alarm
+    ring_wakeup(reason);
+    ring_wakeup_started(reason);
   }
+  CHECK_STATE("wakeup_handler", false);
+}
+
+// Indicates if the next alarm info text could be different this minute
+// (the text only changes at midnight for 'Today'/'Tomorrow', or once within 10 hours of the
+//  alarm for 'In X hrs, Y mins', otherwise it only changes when the alarms or settings change)
+static bool info_may_change(struct tm *tick_time) {
+  time_t curr_time = time(NULL);
+  
+  if (strip_time(curr_time + get_UTC_offset(tick_time)) != s_info_day) return true;
+  
+  return s_info_alarm_time != 0 && (s_info_alarm_time - curr_time) <= (10 * 60 * 60) + 60;
 }
 
 // Handle clock change events
@@ -1085,7 +1358,8 @@ static void handle_tick(struct tm *tick_time, TimeUnits units_changed) {
   // Show the current time on the main screen
   if ((units_changed & MINUTE_UNIT) != 0) {
     update_clock();
-    if (!s_alarm_active && !s_goob_active && !s_state.snoozing && !s_state.monitoring && !s_state.goob_monitoring) 
+    if (!s_alarm_active && !s_goob_active && !s_state.snoozing && !s_state.monitoring && !s_state.goob_monitoring &&
+        info_may_change(tick_time)) 
       update_alarm_display();
   }
 }
@@ -1106,8 +1380,69 @@ static bool persist_bool(const uint32_t persist_key, bool default_val) {
     return default_val;
 }
 
+// Reads a runtime state slot and returns whether it holds a complete, valid record
+static bool read_runtime_slot(const uint32_t persist_key, struct Runtime_st *runtime) {
+  return persist_read_data(persist_key, runtime, sizeof(*runtime)) == sizeof(*runtime) &&
+    runtime->version == RUNTIME_VER &&
+    runtime->crc == crc16(runtime, offsetof(struct Runtime_st, crc));
+}
+
+// Restores all runtime state from the newest valid slot, falling back to the individual keys
+// used by older versions
+static void load_state() {
+  struct Runtime_st slot_a;
+  struct Runtime_st slot_b;
+  struct Runtime_st *runtime = NULL;
+  
+  bool valid_a = read_runtime_slot(RUNTIME_A_KEY, &slot_a);
+  bool valid_b = read_runtime_slot(RUNTIME_B_KEY, &slot_b);
+  
+  if (valid_a && valid_b)
+    // Both valid, so use the newest (allowing for the sequence number wrapping around)
+    runtime = ((int32_t)(slot_b.seq - slot_a.seq) > 0) ? &slot_b : &slot_a;
+  else if (valid_a)
+    runtime = &slot_a;
+  else if (valid_b)
+    runtime = &slot_b;
+  
+  if (runtime != NULL) {
+    s_runtime_seq = runtime->seq;
+    s_alarms_on = runtime->alarms_on;
+    s_wakeup_id = runtime->wakeup_id;
+    s_wakeup_goob_id = runtime->wakeup_goob_id;
+    s_wakeup_time = runtime->wakeup_time;
+    s_skip_until = runtime->skip_until;
+    s_goob_time = runtime->goob_time;
+    s_state = runtime->state;
+  } else {
+    s_alarms_on = persist_bool(ALARMSON_KEY, true);
+    s_wakeup_id = persist_int(WAKEUPID_KEY, 0);
+    s_wakeup_goob_id = persist_int(WAKEUPGOOBID_KEY, 0);
+    persist_read_data(STATE_KEY, &s_state, sizeof(s_state));
+    persist_read_data(SKIPUNTIL_KEY, &s_skip_until, sizeof(s_skip_until));
+    persist_read_data(GOOBALARMTIME_KEY, &s_goob_time, sizeof(s_goob_time));
+    // Older versions did not save the wakeup time, so get it from the wakeup service this one time
+    if (s_wakeup_id > 0 && !wakeup_query(s_wakeup_id, &s_wakeup_time)) s_wakeup_time = 0;
+  }
+}
+
+// Timer handler that finishes an alarm launch once the alarm is ringing and the main window is showing
+static void finish_ring_launch(void *data) {
+  // Unless the alarm was already snoozed or stopped
+  if (get_alarm_mode() != AM_Ringing && get_alarm_mode() != AM_GooBRinging) return;
+  
+  int32_t reason = (int32_t)(intptr_t)data;
+  ring_wakeup_started(reason);
+  // Only generate the next alarm info (for the app glance) since the alarm UI is showing
+  gen_info_str(get_next_alarm(time(NULL)));
+}
+
 static void init(void) {
   
+  pstats_init();
+  ledger_load();
+  count_launch(launch_reason());
+  
   // Load all the settings
   persist_read_data(ALARMS_KEY, s_alarms, sizeof(s_alarms));
   
@@ -1137,70 +1472,135 @@ static void init(void) {
     s_settings.goob_mode = persist_int(GOOBMODE_KEY, GM_Off);
     s_settings.goob_monitor_period = persist_int(GOOBPERIOD_KEY, 5);  
   }
+  gen_snooze_schedule(&s_settings, &s_snooze_schedule);
    
   // Restore state
-  s_alarms_on = persist_bool(ALARMSON_KEY, true);
-  s_wakeup_id = persist_int(WAKEUPID_KEY, 0);
-  s_wakeup_goob_id = persist_int(WAKEUPGOOBID_KEY, 0);
-  persist_read_data(STATE_KEY, &s_state, sizeof(s_state));
-  persist_read_data(SKIPUNTIL_KEY, &s_skip_until, sizeof(s_skip_until));
-  persist_read_data(GOOBALARMTIME_KEY, &s_goob_time, sizeof(s_goob_time));
+  load_state();
+  
+  // Get the wakeup event (if any) that started the app
+  WakeupId id = 0;
+  int32_t reason = 0;
+  bool wakeup_launch = s_alarms_on && launch_reason() == APP_LAUNCH_WAKEUP;
+  if (wakeup_launch) wakeup_get_launch_event(&id, &reason);
+  
+  if (wakeup_launch && reason == WAKEUP_REASON_DSTCHECK && !s_state.snoozing && !s_state.monitoring) {
+    // A DST check only needs the wakeups redone, so do that straight away without building the UI.
+    // With no window pushed the app exits as soon as init returns
+    pstats_scenario("DST check");
+    count_wakeup(reason);
+    s_next_alarm = get_next_alarm(time(NULL));
+    // Generate the next alarm info for the app glance
+    gen_info_str(s_next_alarm);
+    set_wakeup_delayed(NULL);
+    return;
+  }
+  
+  // Smart Alarm monitoring is handed to the worker, so when it takes it the alarm wakeup is set straight
+  // away and the app exits without building the UI. If the worker can't start yet (e.g. the user is
+  // being asked to confirm replacing another app's worker) the app monitors, so it shows the main screen
+  bool monitor_launch = wakeup_launch && reason == WAKEUP_REASON_MONITOR;
+  int8_t monitor_alarm = NEXT_ALARM_NONE;
+  if (monitor_launch) {
+    pstats_scenario("monitor start");
+    count_wakeup(reason);
+    TRACE_EVENT(TL_INFO, TC_SCHED, TE_Wakeup, reason, id);
+    monitor_alarm = start_smart_monitoring();
+    if (s_worker_monitoring) {
+      s_next_alarm = monitor_alarm;
+      // Generate the next alarm info for the app glance
+      gen_info_str(s_next_alarm);
+      set_wakeup_delayed(NULL);
+      return;
+    }
+  }
+  
+  // If the app was started for an alarm, start vibrating before anything else so the first vibration
+  // isn't delayed. The main window has to be pushed before init returns or the app exits, but the
+  // rest of the alarm start (history, worker and snooze wakeup) waits for the next turn of the event loop
+  bool ring_launch = wakeup_launch && (reason == WAKEUP_REASON_ALARM || reason == WAKEUP_REASON_SNOOZE ||
+                                       reason == WAKEUP_REASON_GOOB);
+  if (ring_launch) {
+    count_wakeup(reason);
+    TRACE_EVENT(TL_INFO, TC_SCHED, TE_Wakeup, reason, id);
+    ring_wakeup(reason);
+  }
   
   // Show the main screen and update the UI
   show_mainwin(s_settings.autoclose_timeout);
   init_click_events(click_config_provider);
   update_onoff(s_alarms_on);
-  settings_update();
+  
+  if (ring_launch)
+    ledger_timer_register(0, finish_ring_launch, (void *)(intptr_t)reason);
+  else
+    settings_update(true);
   
   tick_timer_service_subscribe(MINUTE_UNIT, handle_tick);
   wakeup_service_subscribe(wakeup_handler);
+  app_worker_message_subscribe(worker_message_handler);
+  phoneconfig_init(s_alarms, &s_settings, settings_update, alarm_idle);
   
   if (s_alarms_on) {
-    if(launch_reason() == APP_LAUNCH_WAKEUP) {
-      // The app was started by a wakeup event
-    
-      // Get details and handle the event
-      WakeupId id = 0;
-      int32_t reason = 0;
-      wakeup_get_launch_event(&id, &reason);
+    if (wakeup_launch) {
+      // The app was started by a wakeup event, so handle it
       
       // It app was started for a DST check, exit once the wakeups have been redone (happens on a timer)
       if (reason == WAKEUP_REASON_DSTCHECK) s_dst_check_started = true;
       
-      wakeup_handler(id, reason);
+      // Alarms and Smart Alarm monitoring have already been started above
+      if (monitor_launch)
+        set_wakeup(monitor_alarm);
+      else if (!ring_launch)
+        wakeup_handler(id, reason);
        
     } else {
-      // Make sure a wakeup event is set if needed
-      time_t wakeuptime = 0;
-      time_t wakeupgoobtime = 0;
-      if ((s_wakeup_id == 0 || !wakeup_query(s_wakeup_id, &wakeuptime)) &&
-          (s_wakeup_goob_id == 0 || !wakeup_query(s_wakeup_goob_id, &wakeupgoobtime)))
-        set_wakeup(get_next_alarm());
-      else if (s_wakeup_id != 0 || s_wakeup_goob_id != 0) {
+      // Make sure a wakeup event is set if needed. The saved state records the wakeup times, but check
+      // with the wakeup service that the wakeups are still there (they are lost if the watch was reset)
+      time_t curr_time = time(NULL);
+      bool wakeup_pending = s_wakeup_id > 0 && s_wakeup_time > curr_time && wakeup_query(s_wakeup_id, NULL);
+      bool goob_pending = s_wakeup_goob_id > 0 && s_goob_time > curr_time && wakeup_query(s_wakeup_goob_id, NULL);
+      
+      if (!wakeup_pending && !goob_pending) {
+        // If they were lost while snoozing/monitoring, carry on with it from now
+        if (s_state.snoozing)
+          s_alarm_active = true;
+        else if (s_state.monitoring) {
+          stirring_reset(&s_stirring, history_alarm_time());
+          start_monitoring();
+        }
+        set_wakeup(get_next_alarm(time(NULL)));
+      } else {
         // Else if recovering from a crash or forced exit, restart any snoozing/monitoring
-        if (s_state.goob_monitoring) {
-          show_status(wakeupgoobtime, S_GooBMonitoring);
-          start_accel();
-        } else if (s_state.snoozing) {
+        if (s_state.goob_monitoring && goob_pending) {
+          show_status(s_goob_time, S_GooBMonitoring);
+          start_monitoring();
+        } else if (s_state.snoozing && wakeup_pending) {
           s_alarm_active = true;
-          s_snooze_until = wakeuptime;
-          show_status(wakeuptime, S_Snoozing);
-          if (s_settings.easy_light) start_accel();
-        } else if (s_state.monitoring) {
-          show_status(wakeuptime, S_SmartMonitoring);
-          start_accel();
+          s_snooze_until = s_wakeup_time;
+          show_status(s_wakeup_time, S_Snoozing);
+          if (EASY_LIGHT_ON(s_settings)) start_accel();
+        } else if (s_state.monitoring && wakeup_pending) {
+          show_status(s_wakeup_time, S_SmartMonitoring);
+          stirring_reset(&s_stirring, history_alarm_time());
+          start_monitoring();
         }
+        // Check the recovered state still has its wakeups after the crash or forced exit
+        CHECK_STATE("recover", true);
       }
+      
+      // Handle anything the worker detected while the app wasn't running (the worker launches the app)
+      if (persist_exists(WORKER_EVENT_KEY)) handle_worker_event(persist_read_int(WORKER_EVENT_KEY));
     }
   }
   
   s_loaded = true;
 }
 
+#if FEATURE_APP_GLANCE
 static void update_app_glance(AppGlanceReloadSession *session, size_t limit, void *context) {
   if (limit < 3) return;
   
-  int8_t next_alarm = get_next_alarm();
+  int8_t next_alarm = get_next_alarm(time(NULL));
   AppGlanceResult result;
   
   if (next_alarm == NEXT_ALARM_NONE) {
@@ -1230,7 +1630,7 @@ static void update_app_glance(AppGlanceReloadSession *session, size_t limit, voi
     result = app_glance_add_slice(session, slice);
   } else {
     time_t offset = get_UTC_offset(NULL);
-    time_t alarm_time = alarm_to_timestamp(next_alarm);
+    time_t alarm_time = alarm_to_timestamp(next_alarm, time(NULL));
     time_t now = time(NULL) + offset; // Localtime for comparing day differences
     
     char glance_str[20];
@@ -1290,13 +1690,24 @@ static void update_app_glance(AppGlanceReloadSession *session, size_t limit, voi
     APP_LOG(APP_LOG_LEVEL_ERROR, "Error adding AppGlanceSlice: %d", result);
   }
 }
+#endif
 
 static void deinit(void) {
   
   if (s_accel_service_sub) accel_data_service_unsubscribe();
+  app_worker_message_unsubscribe();
+#if FEATURE_APP_GLANCE
   app_glance_reload(update_app_glance, NULL);
+#endif
   
   hide_mainwin();
+  
+  bitmap_cache_clear();
+  ledger_save();
+  trace_dump();
+  pstats_report();
+  draw_profile_report();
+  heap_report();
 }
 
 int main(void) {
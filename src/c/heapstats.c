@@ -0,0 +1,44 @@
+#include <pebble.h>
+#include "heapstats.h"
+#include "arena.h"
+
+#ifdef HEAP_STATS
+
+// Keeps track of the most heap used (and so least free) and where that happened
+
+static size_t s_peak_used;
+static const char *s_peak_label = "";
+static size_t s_min_free = SIZE_MAX;
+static uint16_t s_over_budget;
+
+// Records the heap usage at a point such as a window being pushed or popped
+void heap_checkpoint(const char *label) {
+  size_t used = heap_bytes_used();
+  size_t free_bytes = heap_bytes_free();
+  
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "Heap at %s: %d used, %d free", label, (int)used, (int)free_bytes);
+  
+  if (used > s_peak_used) {
+    s_peak_used = used;
+    s_peak_label = label;
+  }
+  if (free_bytes < s_min_free) s_min_free = free_bytes;
+  
+  if (free_bytes < HEAP_MIN_FREE) {
+    s_over_budget++;
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Heap over budget at %s: %d free, %d required", label, (int)free_bytes, HEAP_MIN_FREE);
+  }
+}
+
+// Logs the peak heap usage and the headroom left over the budget
+void heap_report(void) {
+  if (s_min_free == SIZE_MAX) return;
+  
+  APP_LOG(APP_LOG_LEVEL_INFO, "Heap peak: %d used at %s, min free %d, headroom %d", (int)s_peak_used, s_peak_label, 
+          (int)s_min_free, (int)s_min_free - HEAP_MIN_FREE);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Arena high water: %d of %d bytes", (int)arena_high_water(), ARENA_SIZE);
+  if (s_over_budget > 0)
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Heap over budget %d times", s_over_budget);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#include <pebble.h>
+
+// Optional tracking of heap usage for checking the headroom left on each platform.
+// Built in with GENTLEWAKE_DIAGNOSTICS=heap (see wscript), it logs the heap used and free at each
+// window push/pop and large allocation, flags any point where less than the budgeted amount is free,
+// and logs the low point on exit
+
+// Minimum amount of heap that should be left free at all times
+#ifdef PBL_PLATFORM_APLITE
+#define HEAP_MIN_FREE 2048
+#else
+#define HEAP_MIN_FREE 8192
+#endif
+
+#ifdef HEAP_STATS
+void heap_checkpoint(const char *label);
+void heap_report(void);
+#else
+#define heap_checkpoint(label)
+#define heap_report()
+#endif
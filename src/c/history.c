@@ -0,0 +1,116 @@
+#include <pebble.h>
+#include "history.h"
+#include "persiststats.h"
+#include "ledger.h"
+
+// Persisted ring of nightly alarm records
+// The record for the current night is saved under its own key while an alarm is in progress, so it
+// survives the app closing between snoozes, and is only read into memory while being changed
+
+#define HISTORY_INDEX_KEY 60
+#define HISTORY_NIGHT_KEY 61
+#define HISTORY_FIRST_KEY 62
+
+// Gets the ring index: next slot to write in the low byte and number of records in the high byte
+static uint16_t get_index() {
+  return persist_exists(HISTORY_INDEX_KEY) ? persist_read_int(HISTORY_INDEX_KEY) : 0;
+}
+
+// Loads the current night's record (empty if there isn't one yet)
+static void load_night(HistoryRecord *night) {
+  if (persist_read_data(HISTORY_NIGHT_KEY, night, sizeof(HistoryRecord)) != sizeof(HistoryRecord))
+    memset(night, 0, sizeof(HistoryRecord));
+}
+
+static void save_night(HistoryRecord *night) {
+  ledger_persist_write_data(HISTORY_NIGHT_KEY, night, sizeof(HistoryRecord));
+}
+
+// Starts a new record for the night, for the time the alarm was set for
+void history_start(time_t alarm_time) {
+  HistoryRecord night;
+  memset(&night, 0, sizeof(night));
+  night.alarm_time = alarm_time;
+  save_night(&night);
+}
+
+// Gets the alarm time the current night's record was started for (0 if there isn't one)
+time_t history_alarm_time(void) {
+  HistoryRecord night;
+  load_night(&night);
+  return night.alarm_time;
+}
+
+// Records when the alarm first went off and whether it was triggered by the Smart Alarm
+void history_triggered(bool smart) {
+  HistoryRecord night;
+  load_night(&night);
+  if (night.trigger_time != 0) return;
+  
+  night.trigger_time = time(NULL);
+  if (night.alarm_time == 0) night.alarm_time = night.trigger_time;
+  if (smart) night.flags |= HF_SMART_TRIGGERED;
+  save_night(&night);
+}
+
+// Sets a flag on the current night's record
+void history_set_flag(uint8_t flag) {
+  HistoryRecord night;
+  load_night(&night);
+  if ((night.flags & flag) == flag) return;
+  
+  night.flags |= flag;
+  save_night(&night);
+}
+
+// Records the number of times the alarm was snoozed
+void history_set_snoozes(uint8_t snooze_count) {
+  if (snooze_count == 0) return;
+  
+  HistoryRecord night;
+  load_night(&night);
+  night.snooze_count = snooze_count;
+  save_night(&night);
+}
+
+// Adds the current night's record to the history once the alarm has been stopped, with the
+// movement saved while Smart Alarm monitoring for the same alarm
+void history_append(void) {
+  HistoryRecord night;
+  load_night(&night);
+  
+  if (night.alarm_time != 0) {
+    MovementEpochs epochs;
+    if (persist_read_data(MOVEMENT_EPOCHS_KEY, &epochs, sizeof(epochs)) == sizeof(epochs) &&
+        epochs.alarm_time == night.alarm_time)
+      memcpy(night.movement, epochs.peak, sizeof(night.movement));
+    
+    uint16_t index = get_index();
+    uint8_t next = index & 0xFF;
+    uint8_t count = index >> 8;
+    
+    ledger_persist_write_data(HISTORY_FIRST_KEY + next, &night, sizeof(HistoryRecord));
+    next = (next + 1) % HISTORY_MAX_NIGHTS;
+    if (count < HISTORY_MAX_NIGHTS) count++;
+    ledger_persist_write_int(HISTORY_INDEX_KEY, (count << 8) | next);
+  }
+  
+  persist_delete(HISTORY_NIGHT_KEY);
+  persist_delete(MOVEMENT_EPOCHS_KEY);
+}
+
+// Gets the number of nights in the history
+uint8_t history_count(void) {
+  return get_index() >> 8;
+}
+
+// Reads a night from the history (index 0 is the most recent)
+bool history_read(uint8_t index, HistoryRecord *record) {
+  uint16_t ring_index = get_index();
+  uint8_t count = ring_index >> 8;
+  
+  if (index >= count) return false;
+  
+  uint8_t slot = ((ring_index & 0xFF) + HISTORY_MAX_NIGHTS - 1 - index) % HISTORY_MAX_NIGHTS;
+  return persist_read_data(HISTORY_FIRST_KEY + slot, record, sizeof(HistoryRecord)) == sizeof(HistoryRecord);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <pebble.h>
+#include "workermsg.h"
+
+// Number of nights kept in the history
+#define HISTORY_MAX_NIGHTS 14
+
+// History record flags
+#define HF_SMART_TRIGGERED 0x01
+#define HF_GOOB_RANG 0x02
+#define HF_GOOB_STOPPED 0x04
+
+// Details for a single night/alarm
+typedef struct HistoryRecord {
+  time_t alarm_time;
+  time_t trigger_time;
+  uint8_t snooze_count;
+  uint8_t flags;
+  // Peak movement (scaled down to fit a byte) for each epoch of Smart Alarm monitoring
+  uint8_t movement[HISTORY_EPOCHS];
+} __attribute__((__packed__)) HistoryRecord;
+
+void history_start(time_t alarm_time);
+time_t history_alarm_time(void);
+void history_triggered(bool smart);
+void history_set_flag(uint8_t flag);
+void history_set_snoozes(uint8_t snooze_count);
+void history_append(void);
+uint8_t history_count(void);
+bool history_read(uint8_t index, HistoryRecord *record);
@@ -0,0 +1,90 @@
+#include <pebble.h>
+#include "historywin.h"
+#include "history.h"
+#include "common.h"
+#include "commonwin.h"
+#include "heapstats.h"
+
+// Screen for showing the alarm history for recent nights
+// (records are read from persistent storage as each row is drawn, so nothing is kept in memory)
+
+static Window *s_window;
+static MenuLayer *s_history_layer;
+
+static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  uint8_t count = history_count();
+  // Always show 1 row so there is something to say when there is no history
+  return count == 0 ? 1 : count;
+}
+
+// Draw a night's details
+static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  HistoryRecord record;
+  char date_str[12];
+  char time_str[8];
+  char details_str[34];
+  
+  if (!history_read(cell_index->row, &record)) {
+    menu_cell_basic_draw(ctx, cell_layer, "No History", "Alarms show here", NULL);
+    return;
+  }
+  
+  time_t alarm_time = record.alarm_time;
+  struct tm *t = localtime(&alarm_time);
+  strftime(date_str, sizeof(date_str), "%a, %b %d", t);
+  
+  if (record.trigger_time == 0) {
+    strncpy(details_str, "Stopped before alarm", sizeof(details_str));
+  } else {
+    time_t trigger_time = record.trigger_time;
+    t = localtime(&trigger_time);
+    gen_time_str(t->tm_hour, t->tm_min, time_str, sizeof(time_str));
+    snprintf(details_str, sizeof(details_str), "%s%s, %d snooze%s%s", time_str, 
+             (record.flags & HF_SMART_TRIGGERED) ? " Smart" : "",
+             record.snooze_count, (record.snooze_count == 1) ? "" : "s",
+             (record.flags & HF_GOOB_RANG) ? ", GooB" : "");
+  }
+  
+  menu_cell_basic_draw(ctx, cell_layer, date_str, details_str, NULL);
+}
+
+static void initialise_ui(void) {
+  GRect bounds;
+  Layer *root_layer = NULL;
+  s_window = window_create_fullscreen(&root_layer, &bounds);
+  
+  s_history_layer = menu_layer_create(bounds);
+  menu_layer_set_click_config_onto_window(s_history_layer, s_window);
+  IF_COLOR(menu_layer_set_normal_colors(s_history_layer, GColorBlack, GColorWhite)); 
+  IF_COLOR(menu_layer_set_highlight_colors(s_history_layer, GColorBlueMoon, GColorWhite));
+  layer_add_child(root_layer, menu_layer_get_layer(s_history_layer));
+}
+
+static void destroy_ui(void) {
+  window_destroy(s_window);
+  menu_layer_destroy(s_history_layer);
+}
+
+static void handle_window_unload(Window* window) {
+  destroy_ui();
+  heap_checkpoint("historywin pop");
+}
+
+void show_historywin(void) {
+  initialise_ui();
+  window_set_window_handlers(s_window, (WindowHandlers) {
+    .unload = handle_window_unload,
+  });
+  
+  menu_layer_set_callbacks(s_history_layer, NULL, (MenuLayerCallbacks){
+    .get_num_rows = menu_get_num_rows_callback,
+    .draw_row = menu_draw_row_callback,
+  });
+  
+  window_stack_push(s_window, true);
+  heap_checkpoint("historywin push");
+}
+
+void hide_historywin(void) {
+  window_stack_remove(s_window, true);
+}
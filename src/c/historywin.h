@@ -0,0 +1,5 @@
+#pragma once
+#include <pebble.h>
+
+void show_historywin(void);
+void hide_historywin(void);
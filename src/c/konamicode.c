@@ -1,8 +1,13 @@
 #include <pebble.h>
 #include "common.h"
 #include "commonwin.h"
+#include "bitmapcache.h"
+#include "heapstats.h"
+#include "ledger.h"
 #include "konamicode.h"
 
+#if FEATURE_KONAMI
+
 // Screen for displaying and receiving a random sequence of button presses like
 // the 'Konami Code' for stopping an active alarm
   
@@ -29,6 +34,17 @@ enum KonamiCodes {
 static enum KonamiCodes s_konami_sequence[5];
 static uint8_t s_current_code = 0;
 
+#ifndef PBL_BW
+// Unselected and selected images for each code, loaded once when the window is created
+// (only for codes used in the sequence)
+static GBitmap *s_code_imgs[KC_Max][2];
+static const uint32_t s_code_img_ids[KC_Max][2] = {
+  {RESOURCE_ID_IMAGE_UP_UNSEL, RESOURCE_ID_IMAGE_UP_SEL},
+  {RESOURCE_ID_IMAGE_RIGHT_UNSEL, RESOURCE_ID_IMAGE_RIGHT_SEL},
+  {RESOURCE_ID_IMAGE_DOWN_UNSEL, RESOURCE_ID_IMAGE_DOWN_SEL}
+};
+#endif
+
 // Generates a random sequence of button presses and stores it in a static array
 static void gen_konami_sequence() {
   
@@ -45,44 +61,47 @@ static void gen_konami_sequence() {
 }
 
 // Gets the matching bitmap for a button code and whether it should show as selected (successfully pressed)
+// (bitmaps are already loaded, so nothing needs to be freed)
 static GBitmap* get_code_img(enum KonamiCodes code, bool selected, GContext *ctx) {
+  if (code >= KC_Max) return NULL;
 #ifdef PBL_BW
+  // Same images as the action bar, inverted when selected
   graphics_context_set_compositing_mode(ctx, (selected ? GCompOpAssignInverted : GCompOpAssign));
   if (code == KC_Up)
-    return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UPACTION2);
+    return s_res_image_upaction2;
   else if (code == KC_Right)
-    return gbitmap_create_with_resource(RESOURCE_ID_IMG_NEXTACTION);
-  else if (code == KC_Down)
-    return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWNACTION2);
+    return s_res_img_nextaction;
   else
-    return NULL;
+    return s_res_image_downaction2;
 #else
-  switch (code) {
-    case KC_Up:
-      if (selected)
-        return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UP_SEL);
-      else
-        return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UP_UNSEL);
-      break;
-    case KC_Right:
-      if (selected)
-        return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_RIGHT_SEL);
-      else
-        return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_RIGHT_UNSEL);
-      break;
-    case KC_Down:
-      if (selected)
-        return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWN_SEL);
-      else
-        return gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWN_UNSEL);
-      break;
-    default:
-      return NULL;
-      break;
-  }
+  return s_code_imgs[code][selected ? 1 : 0];
 #endif
 }
 
+#ifndef PBL_BW
+// Loads the images for the codes in the current sequence
+static void load_code_imgs() {
+  for (uint8_t i = 0; i < 5; i++) {
+    enum KonamiCodes code = s_konami_sequence[i];
+    if (s_code_imgs[code][0] == NULL) {
+      s_code_imgs[code][0] = bitmap_cache_get(s_code_img_ids[code][0]);
+      s_code_imgs[code][1] = bitmap_cache_get(s_code_img_ids[code][1]);
+    }
+  }
+}
+
+static void unload_code_imgs() {
+  for (uint8_t code = 0; code < KC_Max; code++) {
+    for (uint8_t sel = 0; sel < 2; sel++) {
+      if (s_code_imgs[code][sel] != NULL) {
+        bitmap_cache_release(s_code_imgs[code][sel]);
+        s_code_imgs[code][sel] = NULL;
+      }
+    }
+  }
+}
+#endif
+
 // Closes the window after a period of inactivity
 static void close_timeout(void *data) {
   s_tmr_close = NULL;
@@ -92,7 +111,7 @@ static void close_timeout(void *data) {
 // Resets the timer that closes the window after 10 seconds of inactivity
 static void reset_close_timer() {
   if (s_tmr_close == NULL)
-    s_tmr_close = app_timer_register(10000, close_timeout, NULL);
+    s_tmr_close = ledger_timer_register(10000, close_timeout, NULL);
   else
     app_timer_reschedule(s_tmr_close, 10000);
 }
@@ -125,10 +144,8 @@ static void draw_code(Layer *layer, GContext *ctx) {
   // Draw codes
   for (uint8_t i = 0; i < 5; i++) {
     GBitmap *img = get_code_img(s_konami_sequence[i], (i < s_current_code), ctx);
-    if (img != NULL) {
+    if (img != NULL)
       graphics_draw_bitmap_in_rect(ctx, img, GRect(5 + (i * 23), 91, 18, 18));
-      gbitmap_destroy(img);
-    }
   }
 }
 
@@ -138,9 +155,9 @@ static void initialise_ui(void) {
   Layer *root_layer = NULL;
   s_window = window_create_fullscreen(&root_layer, &bounds);
   
-  s_res_img_nextaction = gbitmap_create_with_resource(RESOURCE_ID_IMG_NEXTACTION);
-  s_res_image_upaction2 = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UPACTION2);
-  s_res_image_downaction2 = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWNACTION2);
+  s_res_img_nextaction = bitmap_cache_get(RESOURCE_ID_IMG_NEXTACTION);
+  s_res_image_upaction2 = bitmap_cache_get(RESOURCE_ID_IMAGE_UPACTION2);
+  s_res_image_downaction2 = bitmap_cache_get(RESOURCE_ID_IMAGE_DOWNACTION2);
   s_res_gothic_24 = fonts_get_system_font(FONT_KEY_GOTHIC_24);
   s_res_gothic_14 = fonts_get_system_font(FONT_KEY_GOTHIC_14);
   
@@ -161,6 +178,7 @@ static void initialise_ui(void) {
   // Setup random konami code sequence
   s_current_code = 0;
   gen_konami_sequence();
+  IF_COLOR(load_code_imgs());
   
   // s_layer_code
   s_layer_code = layer_create_with_proc(root_layer, draw_code, 
@@ -173,9 +191,10 @@ static void destroy_ui(void) {
   action_bar_layer_destroy(s_actionbarlayer);
   text_layer_destroy(s_textlayer_backbutton);
   layer_destroy(s_layer_code);
-  gbitmap_destroy(s_res_img_nextaction);
-  gbitmap_destroy(s_res_image_upaction2);
-  gbitmap_destroy(s_res_image_downaction2);
+  bitmap_cache_release(s_res_img_nextaction);
+  bitmap_cache_release(s_res_image_upaction2);
+  bitmap_cache_release(s_res_image_downaction2);
+  IF_COLOR(unload_code_imgs());
 }
 
 // Process a button click to determine if it was successful or not
@@ -184,20 +203,20 @@ static void process_click(enum KonamiCodes code) {
     if (s_current_code == 4) {
       // Successfully entered entire konami code, call callback and close window
       if (s_success_event != NULL) s_success_event();
-      vibes_double_pulse();
+      ledger_vibes_double_pulse();
       hide_konamicode();
     } else {
       // One more successfully entered, move to next code
       s_current_code++;
-      layer_mark_dirty(s_layer_code);
+      MARK_DIRTY(s_layer_code, "next code");
       // Reset inactivity timer
       reset_close_timer();
     }
   } else {
     // Wrong code entered, reset everything to go back to the start
     s_current_code = 0;
-    layer_mark_dirty(s_layer_code);
-    vibes_long_pulse();
+    MARK_DIRTY(s_layer_code, "wrong code");
+    ledger_vibes_long_pulse();
     reset_close_timer();
   }
 }
@@ -223,6 +242,7 @@ static void click_config_provider(void *context) {
 static void handle_window_unload(Window* window) {
   cancel_close_timer();
   destroy_ui();
+  heap_checkpoint("konamicode pop");
 }
 
 // Show the Konami Code window with a method pointer that is called when the entire Konami Code is 
@@ -233,6 +253,7 @@ void show_konamicode(CodeSuccessCallBack callback) {
     .unload = handle_window_unload,
   });
   window_stack_push(s_window, true);
+  heap_checkpoint("konamicode push");
   
   // Store callback for calling later
   s_success_event = callback;
@@ -248,3 +269,4 @@ void hide_konamicode(void) {
   window_stack_remove(s_window, true);
 }
 
+#endif
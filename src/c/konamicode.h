@@ -1,5 +1,13 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
 
 typedef void (*CodeSuccessCallBack)();
 
+#if FEATURE_KONAMI
 void show_konamicode(CodeSuccessCallBack callback);
 void hide_konamicode(void);
+#else
+#define show_konamicode(callback)
+#define hide_konamicode()
+#endif
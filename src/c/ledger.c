@@ -0,0 +1,124 @@
+#include <pebble.h>
+#include "ledger.h"
+#include "common.h"
+#include "persiststats.h"
+
+// Keeps the counts for tonight and last night. A night runs from noon to noon (local time)
+// so a whole night's alarms, snoozes and monitoring are counted together.
+// The counts are saved when the app exits and when the alarm is reset, so the ledger adds one persist
+// write per launch (and one more for last night's counts on the first launch of the night).
+// Its own writes aren't counted
+
+#define LEDGER_KEY 90
+#define LEDGER_LAST_KEY 91
+
+static LedgerRecord s_tonight;
+static LedgerRecord s_last_night;
+static bool s_last_night_changed;
+
+static const char *s_counter_names[LC_Max] = {
+  "Launch: User", "Launch: Wakeup", "Launch: Worker", "Launch: Other",
+  "Wakeup: Alarm", "Wakeup: Snooze", "Wakeup: Monitor", "Wakeup: DST Check", "Wakeup: GooB",
+  "Timers", "Accel Callbacks", "Accel Samples", "Vibe Segments", "Light Calls", "Persist Writes"
+};
+
+// Gets the night the given time belongs to
+static time_t get_night(time_t timestamp) {
+  return strip_time(timestamp + get_UTC_offset(NULL) - (SECONDS_PER_DAY / 2));
+}
+
+// Loads the ledger, starting a new night if the saved one is over
+void ledger_load(void) {
+  time_t night = get_night(time(NULL));
+  
+  if (persist_read_data(LEDGER_KEY, &s_tonight, sizeof(s_tonight)) != sizeof(s_tonight))
+    memset(&s_tonight, 0, sizeof(s_tonight));
+  if (persist_read_data(LEDGER_LAST_KEY, &s_last_night, sizeof(s_last_night)) != sizeof(s_last_night))
+    memset(&s_last_night, 0, sizeof(s_last_night));
+  
+  if (s_tonight.night != night) {
+    if (s_tonight.night != 0) {
+      // Saved along with tonight's counts (until then the saved counts for tonight are still last night's)
+      s_last_night = s_tonight;
+      s_last_night_changed = true;
+    }
+    memset(&s_tonight, 0, sizeof(s_tonight));
+    s_tonight.night = night;
+  }
+}
+
+void ledger_save(void) {
+  if (s_last_night_changed) {
+    persist_write_data(LEDGER_LAST_KEY, &s_last_night, sizeof(s_last_night));
+    s_last_night_changed = false;
+  }
+  persist_write_data(LEDGER_KEY, &s_tonight, sizeof(s_tonight));
+}
+
+void ledger_add(LedgerCounter counter, uint16_t amount) {
+  // Stop at the max instead of wrapping around
+  s_tonight.counts[counter] = (s_tonight.counts[counter] > UINT16_MAX - amount) ? UINT16_MAX : s_tonight.counts[counter] + amount;
+}
+
+AppTimer* ledger_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  ledger_count(LC_Timers);
+  return app_timer_register(timeout_ms, callback, callback_data);
+}
+
+void ledger_light_enable_interaction(void) {
+  ledger_count(LC_LightCalls);
+  light_enable_interaction();
+}
+
+void ledger_vibes_short_pulse(void) {
+  ledger_count(LC_VibeSegments);
+  vibes_short_pulse();
+}
+
+void ledger_vibes_long_pulse(void) {
+  ledger_count(LC_VibeSegments);
+  vibes_long_pulse();
+}
+
+void ledger_vibes_double_pulse(void) {
+  ledger_add(LC_VibeSegments, 3);
+  vibes_double_pulse();
+}
+
+void ledger_vibes_enqueue_custom_pattern(VibePattern pattern) {
+  ledger_add(LC_VibeSegments, pattern.num_segments);
+  vibes_enqueue_custom_pattern(pattern);
+}
+
+// (with PERSIST_STATS on, the writes also go through the persist stats)
+int ledger_persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  ledger_count(LC_PersistWrites);
+  return persist_write_data(key, data, size);
+}
+
+int ledger_persist_write_int(const uint32_t key, const int32_t value) {
+  ledger_count(LC_PersistWrites);
+  return persist_write_int(key, value);
+}
+
+const char* ledger_counter_name(LedgerCounter counter) {
+  return s_counter_names[counter];
+}
+
+const LedgerRecord* ledger_get(bool last_night) {
+  return last_night ? &s_last_night : &s_tonight;
+}
+
+// Exports the ledger to the phone as the records for tonight and last night
+void ledger_send(void) {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) return;
+  
+  LedgerRecord records[2] = { s_tonight, s_last_night };
+  DictionaryResult result = dict_write_data(iter, MESSAGE_KEY_LedgerData, (uint8_t*)records, LEDGER_DATA_LEN);
+  if (result != DICT_OK) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Ledger too big for outbox: %d", result);
+    return;
+  }
+  app_message_outbox_send();
+}
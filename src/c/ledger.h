@@ -0,0 +1,50 @@
+#pragma once
+#include <pebble.h>
+
+// Per-night counts of everything that wakes the watch or uses power, for spotting battery regressions
+
+typedef enum LedgerCounter {
+  LC_LaunchUser,
+  LC_LaunchWakeup,
+  LC_LaunchWorker,
+  LC_LaunchOther,
+  LC_WakeupAlarm,
+  LC_WakeupSnooze,
+  LC_WakeupMonitor,
+  LC_WakeupDSTCheck,
+  LC_WakeupGooB,
+  LC_Timers,
+  LC_AccelCallbacks,
+  LC_AccelSamples,
+  LC_VibeSegments,
+  LC_LightCalls,
+  LC_PersistWrites,
+  LC_Max
+} LedgerCounter;
+
+typedef struct LedgerRecord {
+  time_t night;
+  uint16_t counts[LC_Max];
+} __attribute__((__packed__)) LedgerRecord;
+
+// Size of the exported ledger data (tonight and last night)
+#define LEDGER_DATA_LEN (sizeof(LedgerRecord) * 2)
+
+void ledger_load(void);
+void ledger_save(void);
+void ledger_add(LedgerCounter counter, uint16_t amount);
+const char* ledger_counter_name(LedgerCounter counter);
+const LedgerRecord* ledger_get(bool last_night);
+void ledger_send(void);
+
+#define ledger_count(counter) ledger_add(counter, 1)
+
+// The SDK calls that use power, counted (the app calls these instead of the SDK ones)
+AppTimer* ledger_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+void ledger_light_enable_interaction(void);
+void ledger_vibes_short_pulse(void);
+void ledger_vibes_long_pulse(void);
+void ledger_vibes_double_pulse(void);
+void ledger_vibes_enqueue_custom_pattern(VibePattern pattern);
+int ledger_persist_write_data(const uint32_t key, const void *data, const size_t size);
+int ledger_persist_write_int(const uint32_t key, const int32_t value);
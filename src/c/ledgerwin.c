@@ -0,0 +1,65 @@
+#include <pebble.h>
+#include "ledgerwin.h"
+#include "ledger.h"
+#include "common.h"
+#include "commonwin.h"
+#include "heapstats.h"
+
+// Screen for showing the energy ledger counts for tonight and last night
+
+static Window *s_window;
+static MenuLayer *s_ledger_layer;
+
+static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  return LC_Max;
+}
+
+// Draw a counter for tonight and last night
+static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  char counts_str[28];
+  
+  snprintf(counts_str, sizeof(counts_str), "Tonight %d, Last %d", ledger_get(false)->counts[cell_index->row],
+           ledger_get(true)->counts[cell_index->row]);
+  menu_cell_basic_draw(ctx, cell_layer, ledger_counter_name(cell_index->row), counts_str, NULL);
+}
+
+static void initialise_ui(void) {
+  GRect bounds;
+  Layer *root_layer = NULL;
+  s_window = window_create_fullscreen(&root_layer, &bounds);
+  
+  s_ledger_layer = menu_layer_create(bounds);
+  menu_layer_set_click_config_onto_window(s_ledger_layer, s_window);
+  IF_COLOR(menu_layer_set_normal_colors(s_ledger_layer, GColorBlack, GColorWhite)); 
+  IF_COLOR(menu_layer_set_highlight_colors(s_ledger_layer, GColorBlueMoon, GColorWhite));
+  layer_add_child(root_layer, menu_layer_get_layer(s_ledger_layer));
+}
+
+static void destroy_ui(void) {
+  window_destroy(s_window);
+  menu_layer_destroy(s_ledger_layer);
+}
+
+static void handle_window_unload(Window* window) {
+  destroy_ui();
+  heap_checkpoint("ledgerwin pop");
+}
+
+void show_ledgerwin(void) {
+  initialise_ui();
+  window_set_window_handlers(s_window, (WindowHandlers) {
+    .unload = handle_window_unload,
+  });
+  
+  menu_layer_set_callbacks(s_ledger_layer, NULL, (MenuLayerCallbacks){
+    .get_num_rows = menu_get_num_rows_callback,
+    .draw_row = menu_draw_row_callback,
+  });
+  
+  window_stack_push(s_window, true);
+  heap_checkpoint("ledgerwin push");
+}
+
+void hide_ledgerwin(void) {
+  window_stack_remove(s_window, true);
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include <pebble.h>
+
+void show_ledgerwin(void);
+void hide_ledgerwin(void);
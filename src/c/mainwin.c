@@ -1,6 +1,9 @@
 #include "mainwin.h"
 #include "common.h"
 #include "commonwin.h"
+#include "bitmapcache.h"
+#include "heapstats.h"
+#include "ledger.h"
 
 enum onoff_modes {
   MODE_OFF,
@@ -28,7 +31,18 @@ static Layer *clock_layer;
 static Layer *onoff_layer;
 static Layer *info_layer;
 
-static void draw_box(Layer *layer, GContext *ctx, GColor border_color, GColor back_color, GColor text_color, char *text) {
+// Cached text layout for a box so the text is only measured when it or the box size changes
+typedef struct TextMetrics {
+  bool valid;
+  GSize bounds_size;
+  GRect text_rect;
+} TextMetrics;
+
+static TextMetrics s_onoff_metrics;
+static TextMetrics s_info_metrics;
+
+static void draw_box(Layer *layer, GContext *ctx, GColor border_color, GColor back_color, GColor text_color, 
+                     char *text, TextMetrics *metrics) {
   GRect bounds = layer_get_bounds(layer);
   graphics_context_set_fill_color(ctx, back_color);
   graphics_fill_rect(ctx, layer_get_bounds(layer), PBL_IF_RECT_ELSE(8, 0), GCornersAll);
@@ -36,11 +50,16 @@ static void draw_box(Layer *layer, GContext *ctx, GColor border_color, GColor ba
   graphics_context_set_stroke_color(ctx, border_color);
   graphics_draw_round_rect(ctx, layer_get_bounds(layer), PBL_IF_RECT_ELSE(8, 0));
   graphics_context_set_text_color(ctx, text_color);
-  GSize text_size = graphics_text_layout_get_content_size(text, s_res_gothic_18_bold, 
-                                                          GRect(5, 5, bounds.size.w-10, bounds.size.h-2), 
-                                                          GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter);
-  graphics_draw_text(ctx, text, s_res_gothic_18_bold, 
-                     GRect(5, ((bounds.size.h-text_size.h)/2)-4, bounds.size.w-10, text_size.h), 
+  if (!metrics->valid || metrics->bounds_size.w != bounds.size.w || metrics->bounds_size.h != bounds.size.h) {
+    // Measure the text to vertically center it
+    GSize text_size = graphics_text_layout_get_content_size(text, s_res_gothic_18_bold, 
+                                                            GRect(5, 5, bounds.size.w-10, bounds.size.h-2), 
+                                                            GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter);
+    metrics->text_rect = GRect(5, ((bounds.size.h-text_size.h)/2)-4, bounds.size.w-10, text_size.h);
+    metrics->bounds_size = bounds.size;
+    metrics->valid = true;
+  }
+  graphics_draw_text(ctx, text, s_res_gothic_18_bold, metrics->text_rect, 
                      GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
 }
 
@@ -66,7 +85,7 @@ static void draw_onoff(Layer *layer, GContext *ctx) {
   border_color = GColorWhite;
   fill_color = GColorBlack;
 #endif
-  draw_box(layer, ctx, border_color, fill_color, COLOR_FALLBACK(GColorBlack, GColorWhite), s_onoff_text);
+  draw_box(layer, ctx, border_color, fill_color, COLOR_FALLBACK(GColorBlack, GColorWhite), s_onoff_text, &s_onoff_metrics);
 }
 
 static void draw_clock(Layer *layer, GContext *ctx) {
@@ -85,17 +104,23 @@ static void draw_clock(Layer *layer, GContext *ctx) {
 
 static void draw_info(Layer *layer, GContext *ctx) {
   draw_box(layer, ctx, COLOR_FALLBACK(GColorBlueMoon, GColorWhite), COLOR_FALLBACK(GColorPictonBlue, GColorBlack),
-          COLOR_FALLBACK(GColorBlack, GColorWhite), s_info);
+          COLOR_FALLBACK(GColorBlack, GColorWhite), s_info, &s_info_metrics);
 }
 
 static void initialise_ui(void) {
+  // The shown text and its cached layout outlive the window, so start afresh for the new layers
+  // (else text that hasn't changed since the last window would never be drawn or measured)
+  current_time[0] = '\0';
+  s_info[0] = '\0';
+  s_onoff_metrics.valid = false;
+  s_info_metrics.valid = false;
   
   Layer *root_layer = NULL;
   GRect bounds; 
   s_window = window_create_fullscreen(&root_layer, &bounds);
   
-  s_res_img_standby = gbitmap_create_with_resource(RESOURCE_ID_IMG_STANDBY);
-  s_res_img_settings = gbitmap_create_with_resource(RESOURCE_ID_IMG_SETTINGS);
+  s_res_img_standby = bitmap_cache_get(RESOURCE_ID_IMG_STANDBY);
+  s_res_img_settings = bitmap_cache_get(RESOURCE_ID_IMG_SETTINGS);
   s_res_roboto_bold_subset_49 = fonts_get_system_font(FONT_KEY_ROBOTO_BOLD_SUBSET_49);
   s_res_gothic_18_bold = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
   // action_layer
@@ -133,17 +158,19 @@ static void initialise_ui(void) {
 
 static void destroy_ui(void) {
   window_destroy(s_window);
+  s_window = NULL;
   action_bar_layer_destroy(action_layer);
   layer_destroy(clock_layer);
   layer_destroy(onoff_layer);
   layer_destroy(info_layer);
-  gbitmap_destroy(s_res_img_standby);
-  gbitmap_destroy(s_res_img_settings);
+  bitmap_cache_release(s_res_img_standby);
+  bitmap_cache_release(s_res_img_settings);
 }
 
 static void handle_window_unload(Window* window) {
   destroy_ui();
-  gbitmap_destroy(s_res_img_snooze);
+  bitmap_cache_release(s_res_img_snooze);
+  heap_checkpoint("mainwin pop");
 }
 
 // Handles timer event when app has been idle for X minutes and auto-closes app
@@ -173,7 +200,7 @@ static void restart_autoclose_timer() {
   else {
     // Start or restart auto-close timer (timeout is stored in minutes)
     if (s_autoclose_timer == NULL)
-      s_autoclose_timer = app_timer_register(s_autoclose_timeout * 60 * 1000, autoclose_handler, NULL);
+      s_autoclose_timer = ledger_timer_register(s_autoclose_timeout * 60 * 1000, autoclose_handler, NULL);
     else
       app_timer_reschedule(s_autoclose_timer, s_autoclose_timeout * 60 * 1000); 
   }
@@ -189,13 +216,25 @@ static void handle_window_disappear(Window* window) {
 
 static void set_onoff_text(const char *onoff_text) {
   strncpy(s_onoff_text, onoff_text, sizeof(s_onoff_text));
-  layer_mark_dirty(onoff_layer);
+  s_onoff_metrics.valid = false;
+  MARK_DIRTY(onoff_layer, "on/off text");
 }
 
+// The updates below only change the window once it's built (it isn't when the app is launched in the
+// background, e.g. to hand Smart Alarm monitoring to the worker)
+
 // Updates the clock time
 void update_clock() {
-  clock_copy_time_string(current_time, sizeof(current_time));
-  layer_mark_dirty(clock_layer);
+  if (s_window == NULL) return;
+  
+  char new_time[sizeof(current_time)];
+  clock_copy_time_string(new_time, sizeof(new_time));
+  
+  // Only redraw if the time shown has changed
+  if (strcmp(new_time, current_time) != 0) {
+    strcpy(current_time, new_time);
+    MARK_DIRTY(clock_layer, "clock");
+  }
 }
 
 void init_click_events(ClickConfigProvider click_config_provider) {
@@ -205,6 +244,8 @@ void init_click_events(ClickConfigProvider click_config_provider) {
 // Sets the alarms to show as Enabled or Disbaled
 void update_onoff(bool on) {
   s_alarms_on = on;
+  if (s_window == NULL) return;
+  
   if (on) {
     s_onoff_mode = MODE_ON;
     set_onoff_text("Alarms Enabled");
@@ -219,8 +260,13 @@ void update_onoff(bool on) {
 
 // Updates the info at the bottom of the main window
 void update_info(char* text) {
+  if (s_window == NULL) return;
+  // Nothing to redraw if the text is the same
+  if (strncmp(s_info, text, sizeof(s_info)) == 0) return;
+  
   strncpy(s_info, text, sizeof(s_info));
-  layer_mark_dirty(info_layer);
+  s_info_metrics.valid = false;
+  MARK_DIRTY(info_layer, "info text");
 }
 
 // Updates the timeout period for the auto-close time and restarts the timer if appropriate
@@ -231,6 +277,8 @@ void update_autoclose_timeout(uint8_t timeout) {
 
 // Updates the UI to show alarm as active or not
 void show_alarm_ui(bool on, bool goob) {
+  if (s_window == NULL) return;
+  
   if (on) {
     s_onoff_mode = MODE_ACTIVE;
     stop_autoclose_timer();
@@ -250,6 +298,8 @@ void show_alarm_ui(bool on, bool goob) {
 
 // Update the main window to show snoozing, smart alarm monitoring, or Get Out Of Bed alarm monitoring
 void show_status(time_t alarm_time, status_enum status) {
+  if (s_window == NULL) return;
+  
   s_onoff_mode = MODE_ACTIVE;
   stop_autoclose_timer();
   switch (status) {
@@ -283,7 +333,7 @@ void show_status(time_t alarm_time, status_enum status) {
 // Show the main application window
 void show_mainwin(uint8_t autoclose_timeout) {
   initialise_ui();
-  s_res_img_snooze = gbitmap_create_with_resource(RESOURCE_ID_IMG_SNOOZE);
+  s_res_img_snooze = bitmap_cache_get(RESOURCE_ID_IMG_SNOOZE);
   s_autoclose_timeout = autoclose_timeout;
   window_set_window_handlers(s_window, (WindowHandlers) {
     .unload = handle_window_unload,
@@ -294,9 +344,11 @@ void show_mainwin(uint8_t autoclose_timeout) {
   update_clock();
   
   window_stack_push(s_window, true);
+  heap_checkpoint("mainwin push");
 }
 
 // Close the main application window
 void hide_mainwin(void) {
-  window_stack_remove(s_window, true);
+  // The window is never created when the app is launched in the background
+  if (s_window != NULL) window_stack_remove(s_window, true);
 }
@@ -0,0 +1,134 @@
+#include "movement.h"
+#include "workermsg.h"
+
+// Starts accumulating movement from the next readings, with the epochs for the alarm history
+// counting back from the alarm time (0 to not record them)
+void stirring_reset(StirringDetector *detector, time_t alarm_time) {
+  detector->last_x = 0;
+  detector->last_y = 0;
+  detector->last_z = 0;
+  detector->movement = 0;
+  detector->alarm_time = alarm_time;
+  detector->epoch = -1;
+  detector->epoch_peak = 0;
+}
+
+// Saves the peak movement for the current epoch, adding it to any already saved for the alarm time
+void stirring_save(StirringDetector *detector) {
+  if (detector->epoch < 0 || detector->epoch_peak == 0) return;
+  
+  MovementEpochs epochs;
+  if (persist_read_data(MOVEMENT_EPOCHS_KEY, &epochs, sizeof(epochs)) != sizeof(epochs) ||
+      epochs.alarm_time != detector->alarm_time) {
+    memset(&epochs, 0, sizeof(epochs));
+    epochs.alarm_time = detector->alarm_time;
+  }
+  if (detector->epoch_peak > epochs.peak[detector->epoch]) {
+    epochs.peak[detector->epoch] = detector->epoch_peak;
+    persist_write_data(MOVEMENT_EPOCHS_KEY, &epochs, sizeof(epochs));
+  }
+  detector->epoch_peak = 0;
+}
+
+// Records the movement level in the current epoch, saving the last epoch's peak once it is over
+static void add_to_epoch(StirringDetector *detector, int movement) {
+  if (detector->alarm_time == 0) return;
+  
+  // Epochs count back from the alarm time, so the last epoch is the one just before the alarm
+  int32_t epoch = HISTORY_EPOCHS - 1 - ((detector->alarm_time - time(NULL)) / HISTORY_EPOCH_SECS);
+  if (epoch < 0) epoch = 0;
+  if (epoch >= HISTORY_EPOCHS) epoch = HISTORY_EPOCHS - 1;
+  
+  if (epoch != detector->epoch) {
+    stirring_save(detector);
+    detector->epoch = epoch;
+  }
+  
+  movement >>= 8;
+  if (movement > 255) movement = 255;
+  if (movement > detector->epoch_peak) detector->epoch_peak = movement;
+}
+
+// Adds the accel readings to the accumulated movement and returns it
+// (sustained movement is needed for it to grow, which may indicate stirring)
+int stirring_add(StirringDetector *detector, AccelData *data, uint32_t num_samples) {
+  // Initialize last x, y, z readings
+  if (detector->last_x == 0) detector->last_x = data[0].x;
+  if (detector->last_y == 0) detector->last_y = data[0].y;
+  if (detector->last_z == 0) detector->last_z = data[0].z;
+  
+  int diff;
+  
+  // Get the accel difference for each direction for the last sample period and as positive values
+  // and add to the movement counter
+  for (uint32_t i = 0; i < num_samples; i++) {
+    if (!data[i].did_vibrate) {
+      diff = detector->last_x - data[i].x;
+      detector->movement += (diff > 0 ? diff : -diff);
+      diff = detector->last_y - data[i].y;
+      detector->movement += (diff > 0 ? diff : -diff);
+      diff = detector->last_z - data[i].z;
+      detector->movement += (diff > 0 ? diff : -diff);
+      detector->last_x = data[i].x;
+      detector->last_y = data[i].y;
+      detector->last_z = data[i].z;
+    }
+  }
+  
+  // At rest, movement value can accumulate by about 200, so subtract X on every call so
+  // that sustained movement is required to trigger the alarm
+  detector->movement -= REST_MOVEMENT;
+  
+  if (detector->movement < 0)
+    // Movement counter cannot be negative
+    detector->movement = 0;
+  
+  add_to_epoch(detector, detector->movement);
+  return detector->movement;
+}
+
+// Starts counting arm swings again from the next readings
+void arm_swing_reset(ArmSwingDetector *detector) {
+  detector->count = 0;
+  detector->start = 0;
+}
+
+// Counts arm swings in the accel readings and returns the number so far
+// (5 arm swings with no more than 2 seconds between swings will cancel the Get Out Of Bed alarm)
+uint8_t arm_swing_add(ArmSwingDetector *detector, AccelData *data, uint32_t num_samples) {
+  time_t curr_time = time(NULL);
+  
+  if (curr_time - detector->start > 2) {
+    // Reset arm swing stats if more than 2 seconds have passed since last registered swing
+    detector->start = curr_time;
+    detector->count = 0;
+    detector->last_dir = -1;
+    detector->x_filtered = data[0].x;
+    detector->y_filtered = data[0].y;
+  }
+  
+  for (uint32_t i = 0; i < num_samples; i++) {
+    if (!data[i].did_vibrate) {
+      // Perform single pass IIR filter on accelerometer values to get smoother motion
+      detector->x_filtered = (detector->x_filtered >> 1) + (data[i].x >> 1);
+      detector->y_filtered = (detector->y_filtered >> 1) + (data[i].y >> 1);
+  
+      // Very simplistic arm swing detection
+      if (detector->x_filtered <= -500 || detector->x_filtered >= 500) {
+        // Arm is probably somewhat vertical
+        if ((detector->y_filtered >= 350 && !detector->last_dir) ||
+            (detector->y_filtered <= 350 && detector->last_dir)) {
+          // Arm probably changing direction, so count as a swing every other time
+          detector->last_dir ^= true;
+          if (detector->last_dir) {
+            detector->count++;
+            // Restart idle countdown
+            detector->start = curr_time;
+          }
+        }
+      }
+    }
+  }
+  
+  return detector->count;
+}
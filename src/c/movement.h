@@ -0,0 +1,36 @@
+#pragma once
+// Built into both the app and the background worker (see wscript), which have different SDK headers
+#ifdef GENTLEWAKE_WORKER
+#include <pebble_worker.h>
+#else
+#include <pebble.h>
+#endif
+
+// Movement detectors for the Smart Alarm and the Get Out Of Bed alarm, shared by the app and the
+// background worker so they always detect the same way
+
+// Accumulated movement for detecting stirring, and the peak in the current epoch for the alarm history
+typedef struct StirringDetector {
+  int16_t last_x;
+  int16_t last_y;
+  int16_t last_z;
+  int movement;
+  time_t alarm_time;
+  int8_t epoch;
+  uint8_t epoch_peak;
+} StirringDetector;
+
+// Arm swings for detecting the user is up
+typedef struct ArmSwingDetector {
+  bool last_dir;
+  uint8_t count;
+  time_t start;
+  int16_t x_filtered;
+  int16_t y_filtered;
+} ArmSwingDetector;
+
+void stirring_reset(StirringDetector *detector, time_t alarm_time);
+int stirring_add(StirringDetector *detector, AccelData *data, uint32_t num_samples);
+void stirring_save(StirringDetector *detector);
+void arm_swing_reset(ArmSwingDetector *detector);
+uint8_t arm_swing_add(ArmSwingDetector *detector, AccelData *data, uint32_t num_samples);
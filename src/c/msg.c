@@ -2,6 +2,9 @@
 #include "msg.h"
 #include "common.h"
 #include "commonwin.h"
+#include "heapstats.h"
+#include "arena.h"
+#include "ledger.h"
 
 // Simple message window that can be set to auto-hide after a certain time
 
@@ -33,8 +36,9 @@ static void draw_msg(Layer *layer, GContext *ctx) {
 }
 
 static void initialise_ui(void) {
-  s_title = malloc(MAX_TITLE);
-  s_msg = malloc(MAX_MSG);
+  s_title = arena_alloc(MAX_TITLE);
+  s_msg = arena_alloc(MAX_MSG);
+  heap_checkpoint("msg text");
   
   Layer *root_layer = NULL;
   GRect bounds; 
@@ -61,8 +65,8 @@ static void destroy_ui(void) {
   graphics_text_attributes_destroy(s_attributes);
 #endif
   
-  free(s_title);
-  free(s_msg);
+  arena_free(s_msg);
+  arena_free(s_title);
 }
 
 static void cancel_autohide(void) {
@@ -75,6 +79,7 @@ static void cancel_autohide(void) {
 static void handle_window_unload(Window* window) {
   cancel_autohide();
   destroy_ui();
+  heap_checkpoint("msg pop");
 }
 
 static void auto_hide(void *data) {
@@ -96,11 +101,12 @@ void show_msg(char *title, char *msg, uint8_t hide_after, bool vibe) {
   s_title[MAX_TITLE-1] = '\0';
   strncpy(s_msg, msg, MAX_MSG);
   s_msg[MAX_MSG-1] = '\0';
-  layer_mark_dirty(s_msg_layer);
+  MARK_DIRTY(s_msg_layer, "message");
   
   window_stack_push(s_window, true);
+  heap_checkpoint("msg push");
   
-  if (vibe) vibes_long_pulse();
+  if (vibe) ledger_vibes_long_pulse();
   
   // Set auto-hide timer
   if (hide_after == 0) {
@@ -109,7 +115,7 @@ void show_msg(char *title, char *msg, uint8_t hide_after, bool vibe) {
     if (s_autohide != NULL)
       app_timer_reschedule(s_autohide, hide_after * 1000);
     else
-      app_timer_register(hide_after * 1000, auto_hide, NULL);
+      ledger_timer_register(hide_after * 1000, auto_hide, NULL);
   }
 }
 
@@ -1,5 +1,6 @@
 #include "common.h"
 #include "periodset.h"
+#include "heapstats.h"
 #include <pebble.h>
 
 // Screen for setting a time period in minutes
@@ -39,6 +40,7 @@ void show_periodset(char *title, uint8_t minutes, uint8_t min_minutes, uint8_t m
   s_set_event = set_event;
   
   window_stack_push(number_window_get_window(s_num_window), true);
+  heap_checkpoint("periodset push");
 }
 
 void hide_periodset(void) {
@@ -50,6 +52,7 @@ void unload_periodset(void) {
   if (s_num_window != NULL) {
     number_window_destroy(s_num_window);
     s_num_window = NULL;
+    heap_checkpoint("periodset pop");
   }
 }
 #else
@@ -57,6 +60,7 @@ void unload_periodset(void) {
 // built-in NumberWindow is broken in OS 3
 
 #include "commonwin.h"
+#include "bitmapcache.h"
 
 #define LEN_PERIOD 3
 
@@ -105,9 +109,9 @@ static void initialise_ui(void) {
   s_res_bitham_30_black = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
   s_res_gothic_28_bold = fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD);
   s_res_gothic_24_bold = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
-  s_res_img_upaction = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UPACTION2);
-  s_res_img_okaction = gbitmap_create_with_resource(RESOURCE_ID_IMG_OKACTION);
-  s_res_img_downaction = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWNACTION2);
+  s_res_img_upaction = bitmap_cache_get(RESOURCE_ID_IMAGE_UPACTION2);
+  s_res_img_okaction = bitmap_cache_get(RESOURCE_ID_IMG_OKACTION);
+  s_res_img_downaction = bitmap_cache_get(RESOURCE_ID_IMAGE_DOWNACTION2);
   
   s_period_layer = layer_create_with_proc(root_layer, draw_period, bounds);
   
@@ -119,18 +123,19 @@ static void destroy_ui(void) {
   window_destroy(s_window);
   layer_destroy(s_period_layer);
   action_bar_layer_destroy(action_layer);
-  gbitmap_destroy(s_res_img_upaction);
-  gbitmap_destroy(s_res_img_okaction);
-  gbitmap_destroy(s_res_img_downaction);
+  bitmap_cache_release(s_res_img_upaction);
+  bitmap_cache_release(s_res_img_okaction);
+  bitmap_cache_release(s_res_img_downaction);
 }
 
 static void handle_window_unload(Window* window) {
   destroy_ui();
+  heap_checkpoint("periodset pop");
 }
 
 static void update_minutes() {
   snprintf(s_minute_str, LEN_PERIOD, "%d", s_minutes);
-  layer_mark_dirty(s_period_layer);
+  MARK_DIRTY(s_period_layer, "minutes");
 }
 
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -180,6 +185,7 @@ void show_periodset(char *title, uint8_t minutes, uint8_t min_minutes, uint8_t m
   window_set_click_config_provider(s_window, click_config_provider);
   
   window_stack_push(s_window, true);
+  heap_checkpoint("periodset push");
 }
 
 void hide_periodset(void) {
@@ -0,0 +1,171 @@
+#define PERSIST_STATS_IMPL
+#include <pebble.h>
+#include "persiststats.h"
+
+#ifdef PERSIST_STATS
+
+// Keeps counts of persist reads and writes for each key and for the current scenario
+// so that flash write amplification can be checked from the app log
+
+// Highest key the app uses (the old settings keys are 0-26, then the settings and runtime state
+// 50-53, history 60-75, worker 80-82, energy ledger 90-91 and settings version 99)
+#define MAX_KEY 99
+// Number of keys the app can use, which is the number the table has room for
+#define MAX_KEYS 48
+
+typedef struct KeyStats {
+  uint32_t key;
+  uint16_t reads;
+  uint16_t writes;
+  uint32_t bytes_written;
+  uint32_t write_ms;
+  uint16_t stored_size;
+} KeyStats;
+
+static KeyStats s_keys[MAX_KEYS];
+static uint8_t s_key_count;
+static const char *s_scenario = "launch";
+static uint16_t s_scenario_writes;
+static uint32_t s_scenario_bytes;
+
+// Gets the stats for a key, adding it if not seen before
+static KeyStats* get_key_stats(const uint32_t key) {
+  for (uint8_t i = 0; i < s_key_count; i++) {
+    if (s_keys[i].key == key) return &s_keys[i];
+  }
+  
+  if (s_key_count == MAX_KEYS) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Persist key %d: no room to count it (MAX_KEYS is %d)", (int)key, MAX_KEYS);
+    return NULL;
+  }
+  
+  KeyStats *stats = &s_keys[s_key_count++];
+  memset(stats, 0, sizeof(KeyStats));
+  stats->key = key;
+  // Count anything already stored under this key towards the quota
+  if (persist_exists(key)) stats->stored_size = persist_get_size(key);
+  return stats;
+}
+
+// Adds every key that already has data stored, so the quota check counts all of it from the start
+// rather than just the keys used so far
+void pstats_init(void) {
+  for (uint32_t key = 0; key <= MAX_KEY; key++) {
+    if (persist_exists(key)) get_key_stats(key);
+  }
+}
+
+// Gets the total size of all the data stored by the keys that have been used
+static uint32_t get_stored_total() {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < s_key_count; i++)
+    total += s_keys[i].stored_size;
+  return total;
+}
+
+static void count_read(const uint32_t key) {
+  KeyStats *stats = get_key_stats(key);
+  if (stats != NULL) stats->reads++;
+}
+
+// Checks a write against the real storage limits, and if ok, times the write and records it
+static int count_write(const uint32_t key, const void *data, const size_t size, 
+                       int (*write_fn)(const uint32_t, const void*, const size_t)) {
+  KeyStats *stats = get_key_stats(key);
+  
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Persist key %d: %d bytes exceeds the %d byte limit", 
+            (int)key, (int)size, PERSIST_DATA_MAX_LENGTH);
+    return E_INVALID_ARGUMENT;
+  }
+  
+  if (get_stored_total() - (stats != NULL ? stats->stored_size : 0) + size > PERSIST_QUOTA) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Persist key %d: %d bytes exceeds the %d byte storage quota", 
+            (int)key, (int)size, PERSIST_QUOTA);
+    return E_OUT_OF_STORAGE;
+  }
+  
+  time_t start_s;
+  uint16_t start_ms;
+  time_ms(&start_s, &start_ms);
+  
+  int result = write_fn(key, data, size);
+  
+  time_t end_s;
+  uint16_t end_ms;
+  time_ms(&end_s, &end_ms);
+  
+  if (stats != NULL) {
+    stats->writes++;
+    stats->bytes_written += size;
+    stats->write_ms += (end_s - start_s) * 1000 + end_ms - start_ms;
+    stats->stored_size = size;
+  }
+  s_scenario_writes++;
+  s_scenario_bytes += size;
+  
+  return result;
+}
+
+static int write_data(const uint32_t key, const void *data, const size_t size) {
+  return persist_write_data(key, data, size);
+}
+
+static int write_int(const uint32_t key, const void *data, const size_t size) {
+  return persist_write_int(key, *(const int32_t *)data);
+}
+
+static int write_bool(const uint32_t key, const void *data, const size_t size) {
+  return persist_write_bool(key, *(const bool *)data);
+}
+
+int pstats_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  count_read(key);
+  return persist_read_data(key, buffer, buffer_size);
+}
+
+int32_t pstats_read_int(const uint32_t key) {
+  count_read(key);
+  return persist_read_int(key);
+}
+
+bool pstats_read_bool(const uint32_t key) {
+  count_read(key);
+  return persist_read_bool(key);
+}
+
+int pstats_write_data(const uint32_t key, const void *data, const size_t size) {
+  return count_write(key, data, size, write_data);
+}
+
+int pstats_write_int(const uint32_t key, const int32_t value) {
+  return count_write(key, &value, sizeof(value), write_int);
+}
+
+int pstats_write_bool(const uint32_t key, const bool value) {
+  return count_write(key, &value, sizeof(value), write_bool);
+}
+
+// Logs the writes made during the current scenario and starts counting for a new one
+void pstats_scenario(const char *name) {
+  APP_LOG(APP_LOG_LEVEL_INFO, "Persist scenario '%s': %d writes, %d bytes", 
+          s_scenario, s_scenario_writes, (int)s_scenario_bytes);
+  s_scenario = name;
+  s_scenario_writes = 0;
+  s_scenario_bytes = 0;
+}
+
+// Logs the last scenario and the totals for each key
+void pstats_report(void) {
+  pstats_scenario("exit");
+  
+  for (uint8_t i = 0; i < s_key_count; i++) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Persist key %d: %d reads, %d writes, %d bytes written, %d ms writing, %d bytes stored",
+            (int)s_keys[i].key, s_keys[i].reads, s_keys[i].writes, (int)s_keys[i].bytes_written, 
+            (int)s_keys[i].write_ms, s_keys[i].stored_size);
+  }
+  
+  APP_LOG(APP_LOG_LEVEL_INFO, "Persist total: %d of %d bytes stored", (int)get_stored_total(), PERSIST_QUOTA);
+}
+
+#endif
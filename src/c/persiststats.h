@@ -0,0 +1,35 @@
+#pragma once
+#include <pebble.h>
+
+// Optional accounting of persistent storage usage for checking flash writes.
+// Built in with GENTLEWAKE_DIAGNOSTICS=persist (see wscript), it logs per-key read/write counts,
+// bytes and write times, and the writes made by each scenario (launch, snooze, stop, etc.)
+
+// Total persistent storage available to the app
+#define PERSIST_QUOTA 4096
+
+#ifdef PERSIST_STATS
+void pstats_init(void);
+int pstats_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int32_t pstats_read_int(const uint32_t key);
+bool pstats_read_bool(const uint32_t key);
+int pstats_write_data(const uint32_t key, const void *data, const size_t size);
+int pstats_write_int(const uint32_t key, const int32_t value);
+int pstats_write_bool(const uint32_t key, const bool value);
+void pstats_scenario(const char *name);
+void pstats_report(void);
+
+#ifndef PERSIST_STATS_IMPL
+// Route persist calls through the accounting functions
+#define persist_read_data(key, buffer, buffer_size) pstats_read_data(key, buffer, buffer_size)
+#define persist_read_int(key) pstats_read_int(key)
+#define persist_read_bool(key) pstats_read_bool(key)
+#define persist_write_data(key, data, size) pstats_write_data(key, data, size)
+#define persist_write_int(key, value) pstats_write_int(key, value)
+#define persist_write_bool(key, value) pstats_write_bool(key, value)
+#endif
+#else
+#define pstats_init()
+#define pstats_scenario(name)
+#define pstats_report()
+#endif
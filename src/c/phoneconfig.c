@@ -0,0 +1,202 @@
+#include <pebble.h>
+#include "phoneconfig.h"
+#include "common.h"
+#include "ledger.h"
+
+// Uncomment to check the packed config test vectors (phoneconfig_vectors.h) when the app starts
+//#define PHONECONFIG_SELFTEST
+
+#ifdef PHONECONFIG_SELFTEST
+#include "phoneconfig_vectors.h"
+#endif
+
+// Handles messages from the phone.
+// Exchanges the alarms and settings with the phone configuration page as one packed byte array:
+//   version (1 byte)
+//   7 alarms, Sunday first (enabled, hour, minute - 3 bytes each)
+//   settings (16 bytes, in the order packed below)
+//   CRC16 of all the preceding bytes (2 bytes, low byte first)
+// The config is only applied once all of it has been checked
+
+#define NUM_ALARMS 7
+#define CONFIG_SETTINGS_LEN 16
+#define CONFIG_CRC_POS (1 + (NUM_ALARMS * 3) + CONFIG_SETTINGS_LEN)
+#define CONFIG_LEN (CONFIG_CRC_POS + 2)
+
+static alarm *s_alarms;
+static struct Settings_st *s_settings;
+static SettingsClosedCallBack s_applied_event;
+static ConfigAllowedCallBack s_allowed_event;
+
+static uint8_t* pack_alarm(uint8_t *buf, const alarm *alarm_time) {
+  *buf++ = alarm_time->enabled;
+  *buf++ = alarm_time->hour;
+  *buf++ = alarm_time->minute;
+  return buf;
+}
+
+static const uint8_t* unpack_alarm(const uint8_t *buf, alarm *alarm_time) {
+  alarm_time->enabled = *buf++;
+  alarm_time->hour = *buf++;
+  alarm_time->minute = *buf++;
+  return buf;
+}
+
+// Packs the current alarms and settings for sending to the phone
+static void pack_config(uint8_t *buf) {
+  uint8_t *pos = buf;
+  
+  *pos++ = PHONECONFIG_VER;
+  for (uint8_t i = 0; i < NUM_ALARMS; i++)
+    pos = pack_alarm(pos, &s_alarms[i]);
+  
+  *pos++ = s_settings->snooze_delay;
+  *pos++ = s_settings->dynamic_snooze;
+  *pos++ = s_settings->easy_light;
+  *pos++ = s_settings->smart_alarm;
+  *pos++ = s_settings->monitor_period;
+  *pos++ = s_settings->sensitivity;
+  *pos++ = s_settings->dst_check_day;
+  *pos++ = s_settings->dst_check_hour;
+  *pos++ = s_settings->konamic_code_on;
+  *pos++ = s_settings->vibe_pattern;
+  pos = pack_alarm(pos, &s_settings->one_time_alarm);
+  *pos++ = s_settings->autoclose_timeout;
+  *pos++ = s_settings->goob_mode;
+  *pos++ = s_settings->goob_monitor_period;
+  
+  uint16_t crc = crc16(buf, CONFIG_CRC_POS);
+  *pos++ = crc & 0xFF;
+  *pos = crc >> 8;
+}
+
+static bool valid_bool(uint8_t value) {
+  return value <= 1;
+}
+
+static bool valid_alarm(const alarm *alarm_time) {
+  return valid_bool(alarm_time->enabled) && alarm_time->hour < 24 && alarm_time->minute < 60;
+}
+
+// Checks the settings are all within the ranges that can be set from the settings menu
+static bool valid_settings(const struct Settings_st *settings) {
+  return settings->snooze_delay >= 3 && settings->snooze_delay <= 20 &&
+    valid_bool(settings->dynamic_snooze) && valid_bool(settings->easy_light) && valid_bool(settings->smart_alarm) &&
+    settings->monitor_period >= 5 && settings->monitor_period <= 60 &&
+    settings->sensitivity >= MS_LOW && settings->sensitivity <= MS_HIGH &&
+    (settings->dst_check_day == 0 || settings->dst_check_day == SUNDAY || 
+     settings->dst_check_day == TUESDAY || settings->dst_check_day == FRIDAY) &&
+    settings->dst_check_hour >= 3 && settings->dst_check_hour <= 9 &&
+    valid_bool(settings->konamic_code_on) && settings->vibe_pattern <= VP_NSG2Snooze &&
+    valid_alarm(&settings->one_time_alarm) && settings->autoclose_timeout <= 10 &&
+    settings->goob_mode <= GM_AfterStop && settings->goob_monitor_period >= 5 && settings->goob_monitor_period <= 30;
+}
+
+// Checks and unpacks a config from the phone into the given alarms and settings
+static PhoneConfigResult unpack_config(const uint8_t *buf, uint16_t length, alarm *alarms, 
+                                       struct Settings_st *settings) {
+  if (length != CONFIG_LEN) return PCR_BAD_LENGTH;
+  if (buf[0] != PHONECONFIG_VER) return PCR_BAD_VERSION;
+  if (crc16(buf, CONFIG_CRC_POS) != (buf[CONFIG_CRC_POS] | (buf[CONFIG_CRC_POS+1] << 8))) return PCR_BAD_CHECKSUM;
+  
+  const uint8_t *pos = buf + 1;
+  
+  for (uint8_t i = 0; i < NUM_ALARMS; i++) {
+    pos = unpack_alarm(pos, &alarms[i]);
+    if (!valid_alarm(&alarms[i])) return PCR_BAD_VALUE;
+  }
+  
+  settings->snooze_delay = *pos++;
+  settings->dynamic_snooze = *pos++;
+  settings->easy_light = *pos++;
+  settings->smart_alarm = *pos++;
+  settings->monitor_period = *pos++;
+  settings->sensitivity = *pos++;
+  settings->dst_check_day = *pos++;
+  settings->dst_check_hour = *pos++;
+  settings->konamic_code_on = *pos++;
+  settings->vibe_pattern = *pos++;
+  pos = unpack_alarm(pos, &settings->one_time_alarm);
+  settings->autoclose_timeout = *pos++;
+  settings->goob_mode = *pos++;
+  settings->goob_monitor_period = *pos;
+  if (!valid_settings(settings)) return PCR_BAD_VALUE;
+  
+  return PCR_OK;
+}
+
+// Checks and unpacks a config from the phone and applies it if it is all valid
+static PhoneConfigResult apply_config(const uint8_t *buf, uint16_t length) {
+  // Unpack into copies so nothing changes unless everything is valid
+  alarm alarms[NUM_ALARMS];
+  struct Settings_st settings;
+  PhoneConfigResult result = unpack_config(buf, length, alarms, &settings);
+  if (result != PCR_OK) return result;
+  
+  // Like the settings screen, changes can only be made while the alarm is idle
+  if (!s_allowed_event()) return PCR_BUSY;
+  
+  bool changed = memcmp(s_alarms, alarms, sizeof(alarms)) != 0 || memcmp(s_settings, &settings, sizeof(settings)) != 0;
+  memcpy(s_alarms, alarms, sizeof(alarms));
+  memcpy(s_settings, &settings, sizeof(settings));
+  
+  // Update everything the same way as when the settings screen is closed
+  s_applied_event(changed);
+  return PCR_OK;
+}
+
+// Sends the current config, or the result of applying a config, to the phone
+static void send_reply(bool send_config, PhoneConfigResult result) {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) return;
+  
+  if (send_config) {
+    uint8_t buf[CONFIG_LEN];
+    pack_config(buf);
+    dict_write_data(iter, MESSAGE_KEY_ConfigData, buf, sizeof(buf));
+  } else {
+    dict_write_uint8(iter, MESSAGE_KEY_ConfigResult, result);
+  }
+  app_message_outbox_send();
+}
+
+static void inbox_received_handler(DictionaryIterator *iter, void *context) {
+  Tuple *t = dict_find(iter, MESSAGE_KEY_ConfigData);
+  if (t != NULL && t->type == TUPLE_BYTE_ARRAY) {
+    PhoneConfigResult result = apply_config(t->value->data, t->length);
+    if (result != PCR_OK) APP_LOG(APP_LOG_LEVEL_ERROR, "Config from phone rejected: %d", result);
+    send_reply(false, result);
+  } else if (dict_find(iter, MESSAGE_KEY_ConfigRequest) != NULL) {
+    // The configuration page is being opened, so send it the current config
+    send_reply(true, PCR_OK);
+  } else if (dict_find(iter, MESSAGE_KEY_LedgerRequest) != NULL) {
+    ledger_send();
+  }
+}
+
+// Starts listening for config from the phone, which is applied to the given alarms and settings
+void phoneconfig_init(alarm *alarms, struct Settings_st *settings, SettingsClosedCallBack applied_event,
+                      ConfigAllowedCallBack allowed_event) {
+  s_alarms = alarms;
+  s_settings = settings;
+  s_applied_event = applied_event;
+  s_allowed_event = allowed_event;
+  
+#ifdef PHONECONFIG_SELFTEST
+  // Check each test vector unpacks with the expected result
+  alarm test_alarms[NUM_ALARMS];
+  struct Settings_st test_settings;
+  for (uint8_t i = 0; i < ARRAY_LENGTH(s_config_vectors); i++) {
+    const ConfigVector *vector = &s_config_vectors[i];
+    PhoneConfigResult result = unpack_config(vector->data, vector->length, test_alarms, &test_settings);
+    APP_LOG(result == vector->result ? APP_LOG_LEVEL_INFO : APP_LOG_LEVEL_ERROR, "PHONECONFIG_SELFTEST,%s,%s,%d,%d", 
+            vector->name, result == vector->result ? "pass" : "FAIL", vector->result, result);
+  }
+#endif
+  
+  app_message_register_inbox_received(inbox_received_handler);
+  // Size the buffers for the largest messages: the config coming in, and the config or ledger going out
+  uint32_t config_size = dict_calc_buffer_size(1, CONFIG_LEN);
+  uint32_t ledger_size = dict_calc_buffer_size(1, LEDGER_DATA_LEN);
+  app_message_open(config_size, ledger_size > config_size ? ledger_size : config_size);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
+
+// Version of the packed config exchanged with the phone
+#define PHONECONFIG_VER 1
+
+// Results sent back to the phone after a config is received
+typedef enum PhoneConfigResult {
+  PCR_OK = 0,
+  PCR_BAD_LENGTH = 1,
+  PCR_BAD_VERSION = 2,
+  PCR_BAD_CHECKSUM = 3,
+  PCR_BAD_VALUE = 4,
+  PCR_BUSY = 5
+} PhoneConfigResult;
+
+// Returns whether a config can be applied now (only when no alarm is ringing, snoozing or monitoring)
+typedef bool (*ConfigAllowedCallBack)(void);
+
+void phoneconfig_init(alarm *alarms, struct Settings_st *settings, SettingsClosedCallBack applied_event,
+                      ConfigAllowedCallBack allowed_event);
@@ -0,0 +1,25 @@
+#pragma once
+#include <pebble.h>
+#include "phoneconfig.h"
+
+// Packed config test vectors, checked on the watch by PHONECONFIG_SELFTEST (phoneconfig.c) and on
+// the phone side by test/phoneconfig_test.js (which reads this file), so both agree on the format.
+// The valid config is Mon-Fri 7:00 alarms with the default settings.
+// (one vector per line: { "name", result, length, { bytes } })
+
+typedef struct ConfigVector {
+  const char *name;
+  PhoneConfigResult result;
+  uint8_t length;
+  uint8_t data[40];
+} ConfigVector;
+
+static const ConfigVector s_config_vectors[] = {
+  { "valid", PCR_OK, 40, { 0x01, 0x00, 0x08, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x09, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x00, 0x05, 0x25, 0x8D } },
+  { "short", PCR_BAD_LENGTH, 39, { 0x01, 0x00, 0x08, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x09, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x00, 0x05, 0x25 } },
+  { "version", PCR_BAD_VERSION, 40, { 0x02, 0x00, 0x08, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x09, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x00, 0x05, 0xA9, 0xB0 } },
+  { "checksum", PCR_BAD_CHECKSUM, 40, { 0x01, 0x00, 0x08, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x09, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x00, 0x05, 0x25, 0x8C } },
+  { "alarm hour", PCR_BAD_VALUE, 40, { 0x01, 0x00, 0x18, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x09, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x00, 0x05, 0x77, 0x39 } },
+  { "snooze delay", PCR_BAD_VALUE, 40, { 0x01, 0x00, 0x08, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x15, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x00, 0x05, 0x78, 0x3F } },
+  { "goob mode", PCR_BAD_VALUE, 40, { 0x01, 0x00, 0x08, 0x1E, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x01, 0x07, 0x00, 0x00, 0x08, 0x1E, 0x09, 0x01, 0x01, 0x01, 0x1E, 0x02, 0x01, 0x04, 0x00, 0x00, 0x00, 0x06, 0x1E, 0x00, 0x03, 0x05, 0x76, 0xD8 } },
+};
@@ -2,9 +2,13 @@
 #include "settings.h"
 #ifndef PBL_PLATFORM_APLITE
 #include "periodset.h"
+#include "historywin.h"
+#include "ledgerwin.h"
 #endif
 #include "common.h"
 #include "commonwin.h"
+#include "heapstats.h"
+#include "arena.h"
 #include "alarmtime.h"
 
 // Top-Level Settings Screen
@@ -13,12 +17,19 @@
 #define NUM_ALARM_MENU_SECTIONS 1
 
 #define NUM_MAIN_MENU_ALARM_ITEMS 1
-#define NUM_MAIN_MENU_MISC_ITEMS 6
-#define NUM_MAIN_MENU_SMART_ITEMS 4
+#define NUM_MAIN_MENU_MISC_ITEMS (4 + FEATURE_EASY_LIGHT + FEATURE_KONAMI)
+#define NUM_MAIN_MENU_SMART_ITEMS (3 + FEATURE_GOOB)
 #define NUM_MAIN_MENU_DST_ITEMS 2
+#ifdef PBL_PLATFORM_APLITE
 #define NUM_MAIN_MENU_ABOUT_ITEMS 1
+#else
+#define NUM_MAIN_MENU_ABOUT_ITEMS 3
+#endif
 #define NUM_ALARM_MENU_ALARM_ITEMS 9
 
+#define MAX_MENU_ROWS (NUM_MAIN_MENU_ALARM_ITEMS + NUM_MAIN_MENU_MISC_ITEMS + NUM_MAIN_MENU_SMART_ITEMS + \
+                       NUM_MAIN_MENU_DST_ITEMS + NUM_MAIN_MENU_ABOUT_ITEMS)
+
 #define MAIN_MENU_ALARM_SECTION 0
 #define MAIN_MENU_MISC_SECTION 1
 #define MAIN_MENU_SMART_SECTION 2
@@ -29,10 +40,11 @@
 
 #define MAIN_MENU_SNOOZEDELAY_ITEM 0
 #define MAIN_MENU_DYNAMICSNOOZE_ITEM 1
+// (rows for compiled out features are removed, so the rows after them move up)
 #define MAIN_MENU_EASYLIGHT_ITEM 2
-#define MAIN_MENU_KONAMICODE_ITEM 3
-#define MAIN_MENU_VIBEPATTERN_ITEM 4
-#define MAIN_MENU_AUTOCLOSE_ITEM 5
+#define MAIN_MENU_KONAMICODE_ITEM (2 + FEATURE_EASY_LIGHT)
+#define MAIN_MENU_VIBEPATTERN_ITEM (2 + FEATURE_EASY_LIGHT + FEATURE_KONAMI)
+#define MAIN_MENU_AUTOCLOSE_ITEM (3 + FEATURE_EASY_LIGHT + FEATURE_KONAMI)
 
 #define MAIN_MENU_SMARTALARM_ITEM 0
 #define MAIN_MENU_SMARTPERIOD_ITEM 1
@@ -42,6 +54,8 @@
 #define MAIN_MENU_DSTDAYCHECK_ITEM 0
 #define MAIN_MENU_DSTDAYHOUR_ITEM 1
 #define MAIN_MENU_VERSION_ITEM 0
+#define MAIN_MENU_HISTORY_ITEM 1
+#define MAIN_MENU_LEDGER_ITEM 2
 
 static enum menulevel_e {
   ML_Main,
@@ -50,17 +64,33 @@ static enum menulevel_e {
 
 static alarm *s_alarms;
 static struct Settings_st *s_settings;
+// Copies of the alarms and settings when opened so changes can be detected on close
+static alarm s_alarms_orig[7];
+static struct Settings_st s_settings_orig;
 static SettingsClosedCallBack s_settings_closed;
 static GFont s_header_font;
   
 static Window *s_window;
 static MenuLayer *settings_layer;
 
+// Text for each menu item, generated only when the settings change so that drawing and
+// scrolling don't have to work it out again
+typedef struct MenuRowText {
+  char title[19];
+  char subtitle[30];
+} MenuRowText;
+
+// (NULL if there wasn't the memory for it, in which case each row's text is generated as it is drawn)
+static MenuRowText *s_rows;
+static uint8_t s_section_start[NUM_MAIN_MENU_SECTIONS];
+
 static void initialise_ui(void) {
   GRect bounds;
   Layer *root_layer = NULL;
   s_window = window_create_fullscreen(&root_layer, &bounds);
   s_header_font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
+  s_rows = arena_alloc(sizeof(MenuRowText) * MAX_MENU_ROWS);
+  heap_checkpoint("settings rows");
   
   // settings_layer
   settings_layer = menu_layer_create(bounds);
@@ -73,10 +103,13 @@ static void initialise_ui(void) {
 static void destroy_ui(void) {
   window_destroy(s_window);
   menu_layer_destroy(settings_layer);
+  arena_free(s_rows);
 #ifndef PBL_PLATFORM_APLITE
   unload_periodset();
 #endif
-  if (s_settings_closed != NULL) s_settings_closed();
+  if (s_settings_closed != NULL) 
+    s_settings_closed(memcmp(s_alarms, s_alarms_orig, sizeof(s_alarms_orig)) != 0 ||
+                      memcmp(s_settings, &s_settings_orig, sizeof(s_settings_orig)) != 0);
 }
 
 // Set menu section count
@@ -188,8 +221,15 @@ static bool is_alarms_mixed() {
   return false;
 }
 
-// Draw menu items
-static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+static void set_row_text(MenuRowText *row_text, const char *title, const char *subtitle) {
+  strncpy(row_text->title, title, sizeof(row_text->title));
+  row_text->title[sizeof(row_text->title)-1] = '\0';
+  strncpy(row_text->subtitle, subtitle, sizeof(row_text->subtitle));
+  row_text->subtitle[sizeof(row_text->subtitle)-1] = '\0';
+}
+
+// Generates the title and subtitle text for a menu item
+static void gen_row_text(MenuIndex *cell_index, MenuRowText *row_text) {
   char alarm_summary[15];
   bool is_mixed = false;
   bool all_off = true;
@@ -198,11 +238,14 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
   char first_day_str[4];
   char last_day_str[4];
   char alarm_str[8];
-  char snooze_str[15];
+  char snooze_str[24];
+  SnoozeSchedule snooze_schedule;
   char monitor_str[15];
   char dst_check_hour_str[6];
   char autoclose_str[17];
+#if FEATURE_GOOB
   char goob_str[27];
+#endif
   
   char daystr[10];
   char alarmtimestr[8];
@@ -262,7 +305,7 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
                   }
                 }
               }
-              menu_cell_basic_draw(ctx, cell_layer, "Set Alarms", alarm_summary, NULL);
+              set_row_text(row_text, "Set Alarms", alarm_summary);
               break;
           }
           break;
@@ -270,40 +313,46 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
         case MAIN_MENU_MISC_SECTION:
           switch (cell_index->row) {
             case MAIN_MENU_SNOOZEDELAY_ITEM:
-              // Set snooze time
-              snprintf(snooze_str, sizeof(snooze_str), "%d minute(s)", s_settings->snooze_delay);
-              menu_cell_basic_draw(ctx, cell_layer, "Max Snooze Delay", snooze_str, NULL);
+              // Set snooze time (showing how many snoozes fit in the snooze window and their total time)
+              gen_snooze_schedule(s_settings, &snooze_schedule);
+              snprintf(snooze_str, sizeof(snooze_str), "%d min (%dx in %d:%02d)", s_settings->snooze_delay,
+                       snooze_schedule.count, snooze_schedule.total / 60, snooze_schedule.total % 60);
+              set_row_text(row_text, "Max Snooze Delay", snooze_str);
               break;
     
             case MAIN_MENU_DYNAMICSNOOZE_ITEM:
               // Enable/Disable Dynamic Snooze
-              menu_cell_basic_draw(ctx, cell_layer, "Dynamic Snooze", s_settings->dynamic_snooze ? "ON - Halves delay" : "OFF", NULL);
+              set_row_text(row_text, "Dynamic Snooze", s_settings->dynamic_snooze ? "ON - Halves delay" : "OFF");
               break;
             
+    #if FEATURE_EASY_LIGHT
             case MAIN_MENU_EASYLIGHT_ITEM:
               // Enable/Disable Easy Light
-              menu_cell_basic_draw(ctx, cell_layer, "Easy Light", s_settings->easy_light ? "ON - Hold up on alarm" : "OFF", NULL);
+              set_row_text(row_text, "Easy Light", s_settings->easy_light ? "ON - Hold up on alarm" : "OFF");
               break;
+    #endif
             
+    #if FEATURE_KONAMI
             case MAIN_MENU_KONAMICODE_ITEM:
               // Enable/Disable Konami Code
-              menu_cell_basic_draw(ctx, cell_layer, "Stop Alarm", s_settings->konamic_code_on ? "Konami Code" : "Double click", NULL);
+              set_row_text(row_text, "Stop Alarm", s_settings->konamic_code_on ? "Konami Code" : "Double click");
               break;
+    #endif
             
             case MAIN_MENU_VIBEPATTERN_ITEM:
               // Change the vibration level
               switch (s_settings->vibe_pattern) {
                 case VP_Gentle:
-                  menu_cell_basic_draw(ctx, cell_layer, "Vibration Pattern", "Gentle (Original)", NULL);
+                  set_row_text(row_text, "Vibration Pattern", "Gentle (Original)");
                   break;
                 case VP_NSG:
-                  menu_cell_basic_draw(ctx, cell_layer, "Vibration Pattern", "Not-So-Gentle (NSG)", NULL);
+                  set_row_text(row_text, "Vibration Pattern", "Not-So-Gentle (NSG)");
                   break;
                 case VP_NSG2Snooze:
-                  menu_cell_basic_draw(ctx, cell_layer, "Vibration Pattern", "NSG After 2 Snoozes", NULL);
+                  set_row_text(row_text, "Vibration Pattern", "NSG After 2 Snoozes");
                   break;
                 default:
-                  menu_cell_basic_draw(ctx, cell_layer, "Vibration Pattern", "???", NULL);
+                  set_row_text(row_text, "Vibration Pattern", "???");
                   break;
               }
               break;
@@ -320,7 +369,7 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
                   snprintf(autoclose_str, sizeof(autoclose_str), "After %d Minutes", s_settings->autoclose_timeout);
                   break;
               }
-              menu_cell_basic_draw(ctx, cell_layer, "Auto Close", autoclose_str, NULL);
+              set_row_text(row_text, "Auto Close", autoclose_str);
               break;
           }
           break;
@@ -329,32 +378,33 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
           switch (cell_index->row) {
             case MAIN_MENU_SMARTALARM_ITEM:
               // Enable/Disable Smart Alarm
-              menu_cell_basic_draw(ctx, cell_layer, "Smart Alarm", s_settings->smart_alarm ? "ON - Alarm on stirring" : "OFF", NULL);
+              set_row_text(row_text, "Smart Alarm", s_settings->smart_alarm ? "ON - Alarm on stirring" : "OFF");
               break;
             
             case MAIN_MENU_SMARTPERIOD_ITEM:
               // Set single day alarm
               snprintf(monitor_str, sizeof(monitor_str), "%d minute(s)", s_settings->monitor_period);
-              menu_cell_basic_draw(ctx, cell_layer, "Monitor Period", monitor_str, NULL);
+              set_row_text(row_text, "Monitor Period", monitor_str);
               break;
             
             case MAIN_MENU_MOVESENSITIVITY_ITEM:
               // Adjust Smart Alarm movement sensitivity
               switch (s_settings->sensitivity) {
                 case MS_LOW:
-                  menu_cell_basic_draw(ctx, cell_layer, "Sensitivity", "Low", NULL);
+                  set_row_text(row_text, "Sensitivity", "Low");
                   break;
                 case MS_MEDIUM:
-                  menu_cell_basic_draw(ctx, cell_layer, "Sensitivity", "Medium", NULL);
+                  set_row_text(row_text, "Sensitivity", "Medium");
                   break;
                 case MS_HIGH:
-                  menu_cell_basic_draw(ctx, cell_layer, "Sensitivity", "High", NULL);
+                  set_row_text(row_text, "Sensitivity", "High");
                   break;
                 default:
-                  menu_cell_basic_draw(ctx, cell_layer, "Sensitivity", "???", NULL);
+                  set_row_text(row_text, "Sensitivity", "???");
                   break;
               }
               break;
+    #if FEATURE_GOOB
             case MAIN_MENU_GOOB_ITEM:
               // Get Out Of Bed Setting
               switch (s_settings->goob_mode) {
@@ -368,8 +418,9 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
                   snprintf(goob_str, sizeof(goob_str), "%d min. after stop alarm", s_settings->goob_monitor_period);
                   break;
               }
-              menu_cell_basic_draw(ctx, cell_layer, "Get out of Bed Alm", goob_str, NULL);
+              set_row_text(row_text, "Get out of Bed Alm", goob_str);
               break;
+    #endif
           }
           break;
         
@@ -378,23 +429,23 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
             case MAIN_MENU_DSTDAYCHECK_ITEM:
               switch (s_settings->dst_check_day) {
                 case 0:
-                  menu_cell_basic_draw(ctx, cell_layer, "DST Check Day", "OFF", NULL);
+                  set_row_text(row_text, "DST Check Day", "OFF");
                   break;
                 case TUESDAY:
-                  menu_cell_basic_draw(ctx, cell_layer, "DST Check Day", "Tuesday", NULL);
+                  set_row_text(row_text, "DST Check Day", "Tuesday");
                   break;
                 case FRIDAY:
-                  menu_cell_basic_draw(ctx, cell_layer, "DST Check Day", "Friday", NULL);
+                  set_row_text(row_text, "DST Check Day", "Friday");
                   break;
                 default:
-                  menu_cell_basic_draw(ctx, cell_layer, "DST Check Day", "Sunday", NULL);
+                  set_row_text(row_text, "DST Check Day", "Sunday");
                   break;
               }
               break;
             
             case MAIN_MENU_DSTDAYHOUR_ITEM:
               snprintf(dst_check_hour_str, sizeof(dst_check_hour_str), "%d AM", s_settings->dst_check_hour);
-              menu_cell_basic_draw(ctx, cell_layer, "DST Check Hour", dst_check_hour_str, NULL);
+              set_row_text(row_text, "DST Check Hour", dst_check_hour_str);
               break;
           }
           break;
@@ -402,7 +453,13 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
         case MAIN_MENU_ABOUT_SECTION:
           switch (cell_index->row) {
             case MAIN_MENU_VERSION_ITEM:
-              menu_cell_basic_draw(ctx, cell_layer, "Version", VERSION, NULL);
+              set_row_text(row_text, "Version", VERSION);
+              break;
+            case MAIN_MENU_HISTORY_ITEM:
+              set_row_text(row_text, "Alarm History", "Recent nights");
+              break;
+            case MAIN_MENU_LEDGER_ITEM:
+              set_row_text(row_text, "Energy Ledger", "Wakeups per night");
               break;
           }
           break;
@@ -420,7 +477,7 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
           else
             snprintf(alarmstr, sizeof(alarmstr), "%s - Hold to turn on", alarmtimestr);
       
-          menu_cell_basic_draw(ctx, cell_layer, "One-Time Alarm", alarmstr, NULL);
+          set_row_text(row_text, "One-Time Alarm", alarmstr);
           break;
     
         case 1:
@@ -435,7 +492,7 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
               snprintf(alarmstr, sizeof(alarmstr), "%s - Hold to turn on", alarmtimestr);
           }
       
-          menu_cell_basic_draw(ctx, cell_layer, "All Days", alarmstr, NULL);
+          set_row_text(row_text, "All Days", alarmstr);
           break;
     
         default:
@@ -446,23 +503,54 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
             snprintf(alarmstr, sizeof(alarmstr), "%s - Hold to turn off", alarmtimestr);
           else
             snprintf(alarmstr, sizeof(alarmstr), "%s - Hold to turn on", alarmtimestr);
-          menu_cell_basic_draw(ctx, cell_layer, daystr, alarmstr, NULL);
+          set_row_text(row_text, daystr, alarmstr);
           break;
       }
       break;
   }
+}
+
+// Regenerates the text for all the menu items at the current menu level
+static void rebuild_rows() {
+  MenuIndex idx;
+  uint8_t pos = 0;
+  uint16_t sections = menu_get_num_sections_callback(settings_layer, NULL);
   
-  
+  for (idx.section = 0; idx.section < sections; idx.section++) {
+    s_section_start[idx.section] = pos;
+    uint16_t rows = menu_get_num_rows_callback(settings_layer, idx.section, NULL);
+    if (s_rows == NULL)
+      pos += rows;
+    else {
+      for (idx.row = 0; idx.row < rows && pos < MAX_MENU_ROWS; idx.row++)
+        gen_row_text(&idx, &s_rows[pos++]);
+    }
+  }
+}
+
+// Draw menu items
+static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  DRAW_PROFILE_BEGIN();
+  uint8_t pos = s_section_start[cell_index->section] + cell_index->row;
+  if (s_rows == NULL) {
+    MenuRowText row_text;
+    gen_row_text(cell_index, &row_text);
+    menu_cell_basic_draw(ctx, cell_layer, row_text.title, row_text.subtitle, NULL);
+  } else if (pos < MAX_MENU_ROWS)
+    menu_cell_basic_draw(ctx, cell_layer, s_rows[pos].title, s_rows[pos].subtitle, NULL);
+  DRAW_PROFILE_END(menu_draw_row_callback);
 }
 
 #ifndef PBL_PLATFORM_APLITE
 static void snoozedelay_set(uint8_t minutes) {
   s_settings->snooze_delay = minutes;
+  rebuild_rows();
   layer_mark_dirty(menu_layer_get_layer(settings_layer));
 }
 
 static void monitorperiod_set(uint8_t minutes) {
   s_settings->monitor_period = minutes;
+  rebuild_rows();
   layer_mark_dirty(menu_layer_get_layer(settings_layer));
 }
 #endif
@@ -492,6 +580,7 @@ static void alarm_set(int8_t day, uint8_t hour, uint8_t minute) {
       s_alarms[day].minute = minute;
       break;
   }
+  rebuild_rows();
   layer_mark_dirty(menu_layer_get_layer(settings_layer));
 }
 
@@ -527,12 +616,16 @@ static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, v
             case MAIN_MENU_DYNAMICSNOOZE_ITEM:
               s_settings->dynamic_snooze = !s_settings->dynamic_snooze;
               break;
+    #if FEATURE_EASY_LIGHT
             case MAIN_MENU_EASYLIGHT_ITEM:
               s_settings->easy_light = !s_settings->easy_light;
               break;
+    #endif
+    #if FEATURE_KONAMI
             case MAIN_MENU_KONAMICODE_ITEM:
               s_settings->konamic_code_on = !s_settings->konamic_code_on;
               break;
+    #endif
             case MAIN_MENU_VIBEPATTERN_ITEM:
               s_settings->vibe_pattern = (s_settings->vibe_pattern == VP_NSG2Snooze ? VP_Gentle : s_settings->vibe_pattern + 1);
               break;
@@ -557,6 +650,7 @@ static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, v
             case MAIN_MENU_MOVESENSITIVITY_ITEM:
               s_settings->sensitivity = (s_settings->sensitivity == MS_HIGH ? MS_LOW : s_settings->sensitivity + 1);
               break;
+    #if FEATURE_GOOB
             case MAIN_MENU_GOOB_ITEM:
               if (s_settings->goob_mode == GM_AfterStop && s_settings->goob_monitor_period == 30) {
                 s_settings->goob_mode = GM_Off;
@@ -571,6 +665,7 @@ static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, v
                 s_settings->goob_monitor_period += 5;
               }
               break;
+    #endif
           }
           break;
         
@@ -600,6 +695,19 @@ static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, v
               break;
           }
           break;
+        
+        case MAIN_MENU_ABOUT_SECTION:
+          switch (cell_index->row) {
+    #ifndef PBL_PLATFORM_APLITE
+            case MAIN_MENU_HISTORY_ITEM:
+              show_historywin();
+              break;
+            case MAIN_MENU_LEDGER_ITEM:
+              show_ledgerwin();
+              break;
+    #endif
+          }
+          break;
       }
       break;
     
@@ -635,6 +743,7 @@ static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, v
       break;
   }
   
+  rebuild_rows();
   layer_mark_dirty(menu_layer_get_layer(settings_layer));
 }
 
@@ -687,6 +796,7 @@ static void menu_longselect_callback(MenuLayer *menu_layer, MenuIndex *cell_inde
           }
           break;
       }
+      rebuild_rows();
       layer_mark_dirty(menu_layer_get_layer(settings_layer));
       break;
   }
@@ -699,6 +809,7 @@ static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
       break;
     case ML_Alarms:
       s_menulevel = ML_Main;
+      rebuild_rows();
       menu_layer_reload_data(settings_layer);
       MenuIndex idx = {.section = MAIN_MENU_ALARM_SECTION, .row = MAIN_MENU_ALARMS_ITEM};
       menu_layer_set_selected_index(settings_layer, idx, MenuRowAlignCenter, false);
@@ -738,6 +849,7 @@ static void click_config_provider(void *context) {
 
 static void handle_window_unload(Window* window) {
   destroy_ui();
+  heap_checkpoint("settings pop");
 }
 
 void show_settings(alarm *alarms, struct Settings_st *settings, SettingsClosedCallBack settings_closed) {
@@ -749,6 +861,9 @@ void show_settings(alarm *alarms, struct Settings_st *settings, SettingsClosedCa
   s_alarms = alarms;
   s_settings = settings;
   s_settings_closed = settings_closed;
+  memcpy(s_alarms_orig, alarms, sizeof(s_alarms_orig));
+  memcpy(&s_settings_orig, settings, sizeof(s_settings_orig));
+  rebuild_rows();
   
   // Set all the callbacks for the menu layer
   menu_layer_set_callbacks(settings_layer, NULL, (MenuLayerCallbacks){
@@ -762,6 +877,7 @@ void show_settings(alarm *alarms, struct Settings_st *settings, SettingsClosedCa
   window_set_click_config_provider(s_window, click_config_provider);
   
   window_stack_push(s_window, true);
+  heap_checkpoint("settings push");
 }
 
 void hide_settings(void) {
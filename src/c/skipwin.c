@@ -2,6 +2,11 @@
 #include "skipwin.h"
 #include "common.h"
 #include "commonwin.h"
+#include "bitmapcache.h"
+#include "heapstats.h"
+#include "arena.h"
+
+#if FEATURE_SKIP_UNTIL
 
 #define LEN_DATE 12
 
@@ -38,15 +43,16 @@ static void draw_info(Layer *layer, GContext *ctx) {
 }
 
 static void initialise_ui(void) {
-  s_date = malloc(LEN_DATE);
+  s_date = arena_alloc(LEN_DATE);
+  heap_checkpoint("skipwin date");
   
   GRect bounds;
   Layer *root_layer = NULL;
   s_window = window_create_fullscreen(&root_layer, &bounds);
   
-  s_res_img_upaction = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_UPACTION2);
-  s_res_img_okaction = gbitmap_create_with_resource(RESOURCE_ID_IMG_OKACTION);
-  s_res_img_downaction = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_DOWNACTION2);
+  s_res_img_upaction = bitmap_cache_get(RESOURCE_ID_IMAGE_UPACTION2);
+  s_res_img_okaction = bitmap_cache_get(RESOURCE_ID_IMG_OKACTION);
+  s_res_img_downaction = bitmap_cache_get(RESOURCE_ID_IMAGE_DOWNACTION2);
   s_res_gothic_24 = fonts_get_system_font(FONT_KEY_GOTHIC_24);
   s_res_gothic_28 = fonts_get_system_font(FONT_KEY_GOTHIC_28);
   // s_actionbarlayer
@@ -61,15 +67,16 @@ static void destroy_ui(void) {
   window_destroy(s_window);
   action_bar_layer_destroy(s_actionbarlayer);
   layer_destroy(s_info_layer);
-  gbitmap_destroy(s_res_img_upaction);
-  gbitmap_destroy(s_res_img_okaction);
-  gbitmap_destroy(s_res_img_downaction);
+  bitmap_cache_release(s_res_img_upaction);
+  bitmap_cache_release(s_res_img_okaction);
+  bitmap_cache_release(s_res_img_downaction);
   
-  free(s_date);
+  arena_free(s_date);
 }
 
 static void handle_window_unload(Window* window) {
   destroy_ui();
+  heap_checkpoint("skipwin pop");
 }
 
 static time_t get_today() {
@@ -81,7 +88,7 @@ static void update_date_display() {
   struct tm *t = localtime(&skip_utc);
   strftime(s_date, LEN_DATE, "%a, %b %d", t);
   s_show_noskip = (s_skip_until <= get_today());
-  layer_mark_dirty(s_info_layer);
+  MARK_DIRTY(s_info_layer, "skip date");
 }
 
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -150,8 +157,11 @@ void show_skipwin(time_t skip_until, SkipSetCallBack set_event) {
   update_date_display();
   
   window_stack_push(s_window, true);
+  heap_checkpoint("skipwin push");
 }
 
 void hide_skipwin(void) {
   window_stack_remove(s_window, true);
 }
+
+#endif
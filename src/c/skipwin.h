@@ -1,6 +1,12 @@
 #include <pebble.h>
+#include "common.h"
 
 typedef void (*SkipSetCallBack)(time_t skip_until);
 
+#if FEATURE_SKIP_UNTIL
 void show_skipwin(time_t skip_until, SkipSetCallBack set_event);
 void hide_skipwin(void);
+#else
+#define show_skipwin(skip_until, set_event)
+#define hide_skipwin()
+#endif
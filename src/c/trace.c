@@ -0,0 +1,64 @@
+#include <pebble.h>
+#include "trace.h"
+
+#ifdef TRACE
+
+// Number of events kept (the oldest are overwritten once full)
+#define TRACE_SIZE 64
+
+typedef struct TraceRecord {
+  uint32_t time;
+  uint16_t ms;
+  uint8_t event;
+  int32_t a;
+  int32_t b;
+} TraceRecord;
+
+// Log format for each event, given its 2 values (formats may ignore either value)
+static const char *s_formats[TE_Max] = {
+  "sched: wakeup reason %d set for %d",
+  "sched: wakeup reason %d failed with %d",
+  "sched: wakeup reason %d (id %d)",
+  "accel: movement %d (threshold %d)",
+  "accel: arm swing reset",
+  "accel: arm swing %d",
+  "accel: GooB x %d, y %d",
+  "vibe: step %d, %d segments",
+  "persist: state saved, seq %d",
+  "ui: alarm UI on %d, GooB %d"
+};
+
+static TraceRecord s_records[TRACE_SIZE];
+static uint8_t s_next;
+static bool s_wrapped;
+
+void trace_record(TraceEvent event, int32_t a, int32_t b) {
+  TraceRecord *record = &s_records[s_next];
+  time_t secs;
+  time_ms(&secs, &record->ms);
+  record->time = secs;
+  record->event = event;
+  record->a = a;
+  record->b = b;
+  
+  if (++s_next == TRACE_SIZE) {
+    s_next = 0;
+    s_wrapped = true;
+  }
+}
+
+// Logs all the recorded events, oldest first
+void trace_dump(void) {
+  char msg[64];
+  uint8_t count = s_wrapped ? TRACE_SIZE : s_next;
+  uint8_t pos = s_wrapped ? s_next : 0;
+  
+  for (uint8_t i = 0; i < count; i++) {
+    TraceRecord *record = &s_records[pos];
+    snprintf(msg, sizeof(msg), s_formats[record->event], (int)record->a, (int)record->b);
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "%lu.%03d %s", (unsigned long)record->time, record->ms, msg);
+    pos = (pos + 1) % TRACE_SIZE;
+  }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#include <pebble.h>
+
+// Optional tracing of app events into a RAM ring buffer.
+// Events are stored as fixed-size binary records and only formatted when the buffer is dumped to
+// the log on exit, so tracing doesn't flood the log or cost much power while running.
+// Built in with GENTLEWAKE_DIAGNOSTICS=trace (see wscript). The level and categories to record can be
+// set below (anything else compiles away)
+
+#define TL_ERROR 1
+#define TL_INFO 2
+#define TL_DEBUG 3
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TL_INFO
+#endif
+
+// Trace categories
+#define TC_SCHED 0x01
+#define TC_ACCEL 0x02
+#define TC_VIBE 0x04
+#define TC_PERSIST 0x08
+#define TC_UI 0x10
+
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES (TC_SCHED | TC_ACCEL | TC_VIBE | TC_PERSIST | TC_UI)
+#endif
+
+// Traced events (the meaning of the 2 values for each is given by its format in trace.c)
+typedef enum TraceEvent {
+  TE_WakeupScheduled,
+  TE_WakeupFailed,
+  TE_Wakeup,
+  TE_Movement,
+  TE_ArmSwingReset,
+  TE_ArmSwing,
+  TE_GooBFiltered,
+  TE_VibeStep,
+  TE_StateSaved,
+  TE_AlarmUI,
+  TE_Max
+} TraceEvent;
+
+#ifdef TRACE
+void trace_record(TraceEvent event, int32_t a, int32_t b);
+void trace_dump(void);
+
+#define TRACE_EVENT(level, category, event, a, b) \
+  do { if ((level) <= TRACE_LEVEL && ((category) & TRACE_CATEGORIES)) trace_record(event, a, b); } while (0)
+#else
+#define TRACE_EVENT(level, category, event, a, b) do { } while (0)
+#define trace_dump()
+#endif
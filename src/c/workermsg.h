@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+// Shared between the app and the background worker that monitors movement for the
+// Smart Alarm and the Get Out Of Bed alarm
+// (included by both, so only uses types available to each)
+
+// Worker config saved by the app before launching the worker
+#define WORKER_CONFIG_KEY 80
+// Last worker event, saved by the worker for the app to handle when it is launched
+#define WORKER_EVENT_KEY 81
+// Movement for the alarm history while Smart Alarm monitoring (MovementEpochs), saved by whichever
+// of the app and the worker is monitoring
+#define MOVEMENT_EPOCHS_KEY 82
+
+// Number of Smart Alarm monitoring periods (epochs) movement is summarized for
+#define HISTORY_EPOCHS 12
+// Length of each movement epoch in seconds
+#define HISTORY_EPOCH_SECS (5 * 60)
+
+// At rest, movement value can accumulate by about 200 per accel callback
+#define REST_MOVEMENT 300
+// Number of arm swings that will cancel the Get Out Of Bed alarm
+#define GOOB_ARM_SWINGS 5
+
+typedef enum WorkerMode {
+  WM_None,
+  WM_Smart,  // Watch for stirring for the Smart Alarm
+  WM_GooB    // Watch for arm swings that show the user is up
+} WorkerMode;
+
+// AppWorkerMessage types
+typedef enum WorkerMsgType {
+  WMT_Config = 1,   // App -> worker: the config saved under WORKER_CONFIG_KEY has changed
+  WMT_Stirring = 3, // Worker -> app: movement is over the Smart Alarm threshold
+  WMT_GooBStopped,  // Worker -> app: arm swings have stopped the Get Out Of Bed alarm
+  WMT_Monitoring    // Worker -> app: the worker has started and is monitoring (it may only start once
+                    //                the user confirms it can replace another app's worker)
+} WorkerMsgType;
+
+typedef struct WorkerConfig {
+  uint8_t mode;
+  uint16_t threshold;
+  int32_t alarm_time;  // Alarm time the Smart Alarm movement epochs count back from
+} __attribute__((__packed__)) WorkerConfig;
+
+// Peak movement (scaled down to fit a byte) for each epoch before the alarm time, saved once an
+// epoch is over rather than on every reading
+typedef struct MovementEpochs {
+  int32_t alarm_time;
+  uint8_t peak[HISTORY_EPOCHS];
+} __attribute__((__packed__)) MovementEpochs;
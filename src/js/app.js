@@ -0,0 +1,155 @@
+// Phone side configuration for Gentle Wake
+// The watch sends its current alarms and settings when the configuration page is opened, and the
+// changed config is sent back in the same packed format (see phoneconfig.c on the watch)
+
+var CONFIG_VER = 1;
+var NUM_ALARMS = 7;
+var CONFIG_CRC_POS = 1 + (NUM_ALARMS * 3) + 16;
+var CONFIG_LEN = CONFIG_CRC_POS + 2;
+
+var SETTINGS_FIELDS = ['snooze_delay', 'dynamic_snooze', 'easy_light', 'smart_alarm', 'monitor_period',
+                       'sensitivity', 'dst_check_day', 'dst_check_hour', 'konamic_code_on', 'vibe_pattern',
+                       'one_time_enabled', 'one_time_hour', 'one_time_minute', 'autoclose_timeout',
+                       'goob_mode', 'goob_monitor_period'];
+
+var LEDGER_COUNTERS = ['Launch: User', 'Launch: Wakeup', 'Launch: Worker', 'Launch: Other',
+                       'Wakeup: Alarm', 'Wakeup: Snooze', 'Wakeup: Monitor', 'Wakeup: DST Check', 'Wakeup: GooB',
+                       'Timers', 'Accel Callbacks', 'Accel Samples', 'Vibe Segments', 'Light Calls', 'Persist Writes'];
+var LEDGER_RECORD_LEN = 4 + (LEDGER_COUNTERS.length * 2);
+
+var RESULT_MSGS = ['Settings saved', 'Bad length', 'Unsupported version', 'Bad checksum', 'Invalid value',
+                   'Alarm in progress, try again when it is stopped'];
+
+// CRC-16/CCITT (same as crc16() on the watch)
+function crc16(bytes, len) {
+  var crc = 0xFFFF;
+  for (var i = 0; i < len; i++) {
+    crc ^= bytes[i] << 8;
+    for (var bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+      crc &= 0xFFFF;
+    }
+  }
+  return crc;
+}
+
+// Packs a config object into the byte array sent to the watch
+function packConfig(config) {
+  var bytes = [CONFIG_VER];
+  for (var i = 0; i < NUM_ALARMS; i++) {
+    var alarm = config.alarms[i];
+    bytes.push(alarm.enabled ? 1 : 0, alarm.hour, alarm.minute);
+  }
+  for (var j = 0; j < SETTINGS_FIELDS.length; j++) {
+    var value = config.settings[SETTINGS_FIELDS[j]];
+    bytes.push(typeof value === 'boolean' ? (value ? 1 : 0) : value);
+  }
+  var crc = crc16(bytes, CONFIG_CRC_POS);
+  bytes.push(crc & 0xFF, crc >> 8);
+  return bytes;
+}
+
+// Unpacks the byte array sent by the watch into a config object (or null if it isn't valid)
+function unpackConfig(bytes) {
+  if (bytes.length !== CONFIG_LEN || bytes[0] !== CONFIG_VER ||
+      crc16(bytes, CONFIG_CRC_POS) !== (bytes[CONFIG_CRC_POS] | (bytes[CONFIG_CRC_POS + 1] << 8)))
+    return null;
+  
+  var config = { alarms: [], settings: {} };
+  var pos = 1;
+  for (var i = 0; i < NUM_ALARMS; i++) {
+    config.alarms.push({ enabled: bytes[pos] === 1, hour: bytes[pos + 1], minute: bytes[pos + 2] });
+    pos += 3;
+  }
+  for (var j = 0; j < SETTINGS_FIELDS.length; j++)
+    config.settings[SETTINGS_FIELDS[j]] = bytes[pos++];
+  return config;
+}
+
+// Reads a little endian unsigned value from a byte array
+function readUint(bytes, pos, len) {
+  var value = 0;
+  for (var i = len - 1; i >= 0; i--)
+    value = (value * 256) + bytes[pos + i];
+  return value;
+}
+
+// Logs the energy ledger records (tonight and last night) sent by the watch
+function logLedger(bytes) {
+  var names = ['Tonight', 'Last night'];
+  for (var r = 0; r < 2 && (r + 1) * LEDGER_RECORD_LEN <= bytes.length; r++) {
+    var pos = r * LEDGER_RECORD_LEN;
+    var night = readUint(bytes, pos, 4);
+    if (night === 0) continue;
+    var counts = {};
+    for (var i = 0; i < LEDGER_COUNTERS.length; i++)
+      counts[LEDGER_COUNTERS[i]] = readUint(bytes, pos + 4 + (i * 2), 2);
+    console.log('Energy ledger ' + names[r] + ' (' + new Date(night * 1000).toISOString().substr(0, 10) + '): ' +
+                JSON.stringify(counts));
+  }
+}
+
+// Builds the configuration page (as a data URI so no web hosting is needed)
+function configPage(config) {
+  var days = ['Sunday', 'Monday', 'Tuesday', 'Wednesday', 'Thursday', 'Friday', 'Saturday'];
+  var html = '<!DOCTYPE html><html><head><meta name="viewport" content="width=device-width">' +
+    '<style>body{font-family:sans-serif}label{display:block;margin:6px 0}</style></head><body>' +
+    '<h2>Gentle Wake</h2><h3>Alarms</h3>';
+  
+  for (var i = 0; i < NUM_ALARMS; i++) {
+    html += '<label><input type="checkbox" id="a' + i + 'e"> ' + days[i] + 
+      ' <input type="time" id="a' + i + 't"></label>';
+  }
+  html += '<h3>Settings</h3>';
+  for (var j = 0; j < SETTINGS_FIELDS.length; j++) {
+    html += '<label>' + SETTINGS_FIELDS[j].replace(/_/g, ' ') + 
+      ' <input type="number" id="' + SETTINGS_FIELDS[j] + '"></label>';
+  }
+  html += '<button id="save">Save</button><script>' +
+    'var c=' + JSON.stringify(config) + ',f=' + JSON.stringify(SETTINGS_FIELDS) + ';' +
+    'function p(n){return(n<10?"0":"")+n}' +
+    'for(var i=0;i<7;i++){document.getElementById("a"+i+"e").checked=c.alarms[i].enabled;' +
+    'document.getElementById("a"+i+"t").value=p(c.alarms[i].hour)+":"+p(c.alarms[i].minute)}' +
+    'for(var j=0;j<f.length;j++)document.getElementById(f[j]).value=c.settings[f[j]];' +
+    'document.getElementById("save").onclick=function(){' +
+    'for(var i=0;i<7;i++){var t=document.getElementById("a"+i+"t").value.split(":");' +
+    'c.alarms[i]={enabled:document.getElementById("a"+i+"e").checked,hour:+t[0],minute:+t[1]}}' +
+    'for(var j=0;j<f.length;j++)c.settings[f[j]]=+document.getElementById(f[j]).value;' +
+    'document.location="pebblejs://close#"+encodeURIComponent(JSON.stringify(c))}' +
+    '</script></body></html>';
+  
+  return 'data:text/html,' + encodeURIComponent(html);
+}
+
+Pebble.addEventListener('ready', function() {
+  // Export the energy ledger to the phone log each time the app starts
+  Pebble.sendAppMessage({ 'LedgerRequest': 1 });
+});
+
+Pebble.addEventListener('showConfiguration', function() {
+  // Ask the watch for its current config, which opens the page once received
+  Pebble.sendAppMessage({ 'ConfigRequest': 1 });
+});
+
+Pebble.addEventListener('appmessage', function(e) {
+  if (e.payload.ConfigData !== undefined) {
+    var config = unpackConfig(e.payload.ConfigData);
+    if (config)
+      Pebble.openURL(configPage(config));
+    else
+      console.log('Invalid config from watch');
+  } else if (e.payload.LedgerData !== undefined) {
+    logLedger(e.payload.LedgerData);
+  } else if (e.payload.ConfigResult !== undefined) {
+    console.log(RESULT_MSGS[e.payload.ConfigResult] || ('Config error ' + e.payload.ConfigResult));
+  }
+});
+
+Pebble.addEventListener('webviewclosed', function(e) {
+  if (!e.response) return;
+  
+  var config = JSON.parse(decodeURIComponent(e.response));
+  Pebble.sendAppMessage({ 'ConfigData': packConfig(config) }, null, function() {
+    console.log('Failed to send config to watch');
+  });
+});
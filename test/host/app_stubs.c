@@ -0,0 +1,48 @@
+#include <pebble.h>
+#include "mainwin.h"
+#include "settings.h"
+#include "konamicode.h"
+#include "skipwin.h"
+#include "msg.h"
+#include "bitmapcache.h"
+#include "phoneconfig.h"
+#include "fake_pebble.h"
+
+// Stand-ins for the app's windows, which the host tests don't show. The main window only tells the
+// fakes whether the app has a window open (so it keeps running), and passes on the button handlers
+
+void show_mainwin(uint8_t autoclose_timeout) {
+  fake_window_push();
+}
+
+void hide_mainwin(void) {
+  fake_window_pop_all();
+}
+
+void init_click_events(ClickConfigProvider click_config_provider) {
+  click_config_provider(NULL);
+}
+
+void update_clock() {}
+void update_onoff(bool on) {}
+void update_info(char* text) {}
+void update_autoclose_timeout(uint8_t timeout) {}
+void show_alarm_ui(bool on, bool goob) {}
+void show_status(time_t alarm_time, status_enum status) {}
+
+void show_settings(alarm *alarms, struct Settings_st *settings, SettingsClosedCallBack settings_closed) {}
+void hide_settings(void) {}
+#if FEATURE_KONAMI
+void show_konamicode(CodeSuccessCallBack callback) {}
+void hide_konamicode(void) {}
+#endif
+#if FEATURE_SKIP_UNTIL
+void show_skipwin(time_t skip_until, SkipSetCallBack set_event) {}
+void hide_skipwin(void) {}
+#endif
+void show_msg(char *title, char *msg, uint8_t hide_after, bool vibe) {}
+void hide_msg(void) {}
+
+void bitmap_cache_clear(void) {}
+void phoneconfig_init(alarm *alarms, struct Settings_st *settings, SettingsClosedCallBack applied_event,
+                      ConfigAllowedCallBack allowed_event) {}
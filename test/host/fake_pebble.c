@@ -0,0 +1,553 @@
+#include <pebble.h>
+#include <stdarg.h>
+#include "fake_pebble.h"
+#include "workermsg.h"
+
+// Fake Pebble services for the host tests: a settable clock and timezone, and in-memory
+// persistent storage, wakeups, timers and worker. The clock only moves when a test runs it,
+// firing the timers and wakeups that are due and launching the app for them as the watch would
+
+#define MAX_PERSIST_KEYS 128
+// Same as the wakeup service allows each app
+#define MAX_WAKEUPS 8
+
+static uint64_t s_ms;
+
+static struct {
+  uint32_t key;
+  int size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} s_persist[MAX_PERSIST_KEYS];
+static int s_persist_count;
+
+static struct {
+  WakeupId id;
+  time_t timestamp;
+  int32_t cookie;
+} s_wakeups[MAX_WAKEUPS];
+static WakeupId s_next_wakeup_id = 1;
+
+// Timers are never reused, so a stale handle can't cancel a newer timer
+struct AppTimer {
+  bool active;
+  uint64_t due_ms;
+  AppTimerCallback callback;
+  void *data;
+  struct AppTimer *next;
+};
+static struct AppTimer *s_timers;
+
+static void (*s_app_init)(void);
+static void (*s_app_deinit)(void);
+static bool s_app_running;
+static AppLaunchReason s_launch_reason;
+static WakeupId s_launch_wakeup_id;
+static int32_t s_launch_cookie;
+static uint8_t s_windows;
+static WakeupHandler s_wakeup_handler;
+static AppWorkerMessageHandler s_worker_handler;
+static ClickHandler s_click_handlers[NUM_BUTTONS];
+static ClickHandler s_multi_click_handlers[NUM_BUTTONS];
+
+static bool s_accel_subscribed;
+static bool s_worker_running;
+static bool s_worker_ask_confirmation;
+static FakeCounts s_counts;
+static FakeCounts s_launch_counts;
+static bool s_launch_vibed;
+
+// Counts towards the totals, and the launch's counts until it vibrates
+#define COUNT(field, n) do { s_counts.field += (n); if (!s_launch_vibed) s_launch_counts.field += (n); } while (0)
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  // Only errors are shown, unless HOST_TEST_LOG is set
+  if (log_level != APP_LOG_LEVEL_ERROR && !getenv("HOST_TEST_LOG")) return;
+  va_list args;
+  va_start(args, fmt);
+  printf("  %s:%d ", src_filename, src_line_number);
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+}
+
+void fake_set_timezone(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+void fake_set_time(time_t now) {
+  s_ms = (uint64_t)now * 1000;
+}
+
+time_t fake_utc(int year, int month, int day, int hour, int minute) {
+  struct tm t = { .tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day, .tm_hour = hour, .tm_min = minute };
+  return timegm(&t);
+}
+
+static void clear_timers(void) {
+  while (s_timers) {
+    struct AppTimer *next = s_timers->next;
+    free(s_timers);
+    s_timers = next;
+  }
+}
+
+void fake_reset(void) {
+  fake_kill();
+  s_persist_count = 0;
+  memset(s_wakeups, 0, sizeof(s_wakeups));
+  s_worker_running = false;
+  s_worker_ask_confirmation = false;
+  fake_clear_counts();
+}
+
+// App lifecycle
+
+void fake_set_app(void (*init)(void), void (*deinit)(void)) {
+  s_app_init = init;
+  s_app_deinit = deinit;
+}
+
+// An app with no windows left exits once it has handled an event
+static void exit_if_no_windows(void) {
+  if (s_app_running && s_windows == 0) fake_exit();
+}
+
+void fake_launch(AppLaunchReason reason, WakeupId wakeup_id, int32_t cookie) {
+  if (s_app_running) return;
+  s_launch_reason = reason;
+  s_launch_wakeup_id = wakeup_id;
+  s_launch_cookie = cookie;
+  s_app_running = true;
+  memset(&s_launch_counts, 0, sizeof(s_launch_counts));
+  s_launch_vibed = false;
+  COUNT(launches, 1);
+  s_app_init();
+  exit_if_no_windows();
+}
+
+void fake_kill(void) {
+  s_app_running = false;
+  s_windows = 0;
+  s_wakeup_handler = NULL;
+  s_worker_handler = NULL;
+  s_accel_subscribed = false;
+  memset(s_click_handlers, 0, sizeof(s_click_handlers));
+  memset(s_multi_click_handlers, 0, sizeof(s_multi_click_handlers));
+  clear_timers();
+}
+
+void fake_exit(void) {
+  if (!s_app_running) return;
+  s_app_deinit();
+  fake_kill();
+}
+
+bool fake_app_running(void) {
+  return s_app_running;
+}
+
+static void fire_wakeup(int i) {
+  WakeupId id = s_wakeups[i].id;
+  int32_t cookie = s_wakeups[i].cookie;
+  s_wakeups[i].id = 0;
+  COUNT(wakeups, 1);
+  if (s_app_running && s_wakeup_handler) {
+    s_wakeup_handler(id, cookie);
+    exit_if_no_windows();
+  } else
+    fake_launch(APP_LAUNCH_WAKEUP, id, cookie);
+}
+
+bool fake_run(uint32_t ms, bool until_wakeup) {
+  uint64_t end = s_ms + ms;
+  
+  while (true) {
+    struct AppTimer *timer = NULL;
+    for (struct AppTimer *t = s_timers; t; t = t->next) {
+      if (t->active && (!timer || t->due_ms < timer->due_ms)) timer = t;
+    }
+    int wakeup = -1;
+    for (int i = 0; i < MAX_WAKEUPS; i++) {
+      if (s_wakeups[i].id && (wakeup < 0 || s_wakeups[i].timestamp < s_wakeups[wakeup].timestamp)) wakeup = i;
+    }
+    uint64_t timer_ms = timer ? timer->due_ms : UINT64_MAX;
+    uint64_t wakeup_ms = (wakeup >= 0) ? (uint64_t)s_wakeups[wakeup].timestamp * 1000 : UINT64_MAX;
+    if (timer_ms > end && wakeup_ms > end) break;
+    
+    if (timer_ms <= wakeup_ms) {
+      if (timer_ms > s_ms) s_ms = timer_ms;
+      timer->active = false;
+      timer->callback(timer->data);
+      exit_if_no_windows();
+    } else {
+      if (wakeup_ms > s_ms) s_ms = wakeup_ms;
+      fire_wakeup(wakeup);
+      if (until_wakeup) return true;
+    }
+  }
+  
+  s_ms = end;
+  return false;
+}
+
+uint8_t fake_wakeup_count(uint32_t cookie_mask) {
+  uint8_t count = 0;
+  for (int i = 0; i < MAX_WAKEUPS; i++) {
+    if (s_wakeups[i].id && (cookie_mask & (1 << s_wakeups[i].cookie))) count++;
+  }
+  return count;
+}
+
+void fake_click(ButtonId button_id) {
+  if (!s_click_handlers[button_id]) return;
+  s_click_handlers[button_id]((ClickRecognizerRef)(intptr_t)button_id, NULL);
+  exit_if_no_windows();
+}
+
+void fake_double_click(ButtonId button_id) {
+  if (!s_multi_click_handlers[button_id]) return;
+  s_multi_click_handlers[button_id]((ClickRecognizerRef)(intptr_t)button_id, NULL);
+  exit_if_no_windows();
+}
+
+void fake_worker_event(uint16_t type) {
+  if (!s_worker_running) return;
+  persist_write_int(WORKER_EVENT_KEY, type);
+  if (s_app_running && s_worker_handler) {
+    AppWorkerMessage msg = { .data0 = 0 };
+    s_worker_handler(type, &msg);
+    exit_if_no_windows();
+  } else
+    fake_launch(APP_LAUNCH_WORKER, 0, 0);
+}
+
+bool fake_worker_running(void) {
+  return s_worker_running;
+}
+
+void fake_worker_ask_confirmation(bool ask) {
+  s_worker_ask_confirmation = ask;
+}
+
+void fake_worker_confirm(void) {
+  s_worker_ask_confirmation = false;
+  if (s_worker_running) return;
+  s_worker_running = true;
+  if (s_app_running && s_worker_handler) {
+    AppWorkerMessage msg = { .data0 = 0 };
+    s_worker_handler(WMT_Monitoring, &msg);
+    exit_if_no_windows();
+  }
+}
+
+bool fake_accel_subscribed(void) {
+  return s_accel_subscribed;
+}
+
+void fake_window_push(void) {
+  s_windows++;
+  COUNT(windows, 1);
+}
+
+void fake_window_pop_all(void) {
+  s_windows = 0;
+}
+
+FakeCounts fake_counts(void) {
+  return s_counts;
+}
+
+void fake_clear_counts(void) {
+  memset(&s_counts, 0, sizeof(s_counts));
+}
+
+FakeCounts fake_counts_before_vibe(void) {
+  return s_launch_counts;
+}
+
+// Time
+
+time_t time(time_t *tloc) {
+  time_t now = s_ms / 1000;
+  if (tloc) *tloc = now;
+  return now;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  if (t_utc) *t_utc = s_ms / 1000;
+  if (out_ms) *out_ms = s_ms % 1000;
+  return s_ms % 1000;
+}
+
+// Pebble's tm_gmtoff leaves out the hour added for DST (see get_UTC_offset), so do the same
+struct tm *localtime(const time_t *timep) {
+  static struct tm t;
+  localtime_r(timep, &t);
+  if (t.tm_isdst > 0) t.tm_gmtoff -= 60 * 60;
+  return &t;
+}
+
+// The next time the clock shows the time on the day (today if it is still to come for TODAY)
+time_t clock_to_timestamp(WeekDay day, int hour, int minute) {
+  time_t now = time(NULL);
+  struct tm t;
+  localtime_r(&now, &t);
+  int days = (day == TODAY) ? 0 : ((day - 1) - t.tm_wday + 7) % 7;
+  for (;; days++) {
+    struct tm alarm_t = { .tm_year = t.tm_year, .tm_mon = t.tm_mon, .tm_mday = t.tm_mday + days,
+                          .tm_hour = hour, .tm_min = minute, .tm_isdst = -1 };
+    time_t timestamp = mktime(&alarm_t);
+    if (timestamp > now) return timestamp;
+    if (day != TODAY) days += 6;
+  }
+}
+
+bool clock_is_24h_style(void) {
+  return true;
+}
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {}
+void tick_timer_service_unsubscribe(void) {}
+
+// Timers
+
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  struct AppTimer *timer = malloc(sizeof(struct AppTimer));
+  *timer = (struct AppTimer){ true, s_ms + timeout_ms, callback, callback_data, s_timers };
+  s_timers = timer;
+  COUNT(timers, 1);
+  return timer;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  if (!timer_handle->active) return false;
+  timer_handle->due_ms = s_ms + new_timeout_ms;
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  timer_handle->active = false;
+}
+
+// Wakeups and launching
+
+// Fails the same ways as the wakeup service (including for another wakeup within a minute)
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed) {
+  if (timestamp < time(NULL)) return E_INVALID_ARGUMENT;
+  for (int i = 0; i < MAX_WAKEUPS; i++) {
+    if (s_wakeups[i].id && s_wakeups[i].timestamp > timestamp - 60 && s_wakeups[i].timestamp < timestamp + 60)
+      return E_RANGE;
+  }
+  for (int i = 0; i < MAX_WAKEUPS; i++) {
+    if (!s_wakeups[i].id) {
+      s_wakeups[i].id = s_next_wakeup_id++;
+      s_wakeups[i].timestamp = timestamp;
+      s_wakeups[i].cookie = cookie;
+      return s_wakeups[i].id;
+    }
+  }
+  return E_OUT_OF_RESOURCES;
+}
+
+void wakeup_cancel(WakeupId wakeup_id) {
+  for (int i = 0; i < MAX_WAKEUPS; i++) {
+    if (s_wakeups[i].id == wakeup_id) s_wakeups[i].id = 0;
+  }
+}
+
+void wakeup_cancel_all(void) {
+  memset(s_wakeups, 0, sizeof(s_wakeups));
+}
+
+bool wakeup_query(WakeupId wakeup_id, time_t *timestamp) {
+  for (int i = 0; i < MAX_WAKEUPS; i++) {
+    if (wakeup_id > 0 && s_wakeups[i].id == wakeup_id) {
+      if (timestamp) *timestamp = s_wakeups[i].timestamp;
+      return true;
+    }
+  }
+  return false;
+}
+
+void wakeup_service_subscribe(WakeupHandler handler) {
+  s_wakeup_handler = handler;
+}
+
+void wakeup_get_launch_event(WakeupId *wakeup_id, int32_t *cookie) {
+  *wakeup_id = s_launch_wakeup_id;
+  *cookie = s_launch_cookie;
+}
+
+AppLaunchReason launch_reason(void) {
+  return s_launch_reason;
+}
+
+void app_event_loop(void) {}
+
+// Persistent storage
+
+static int persist_find(uint32_t key) {
+  for (int i = 0; i < s_persist_count; i++) {
+    if (s_persist[i].key == key) return i;
+  }
+  return -1;
+}
+
+bool persist_exists(uint32_t key) {
+  return persist_find(key) >= 0;
+}
+
+int persist_get_size(uint32_t key) {
+  int i = persist_find(key);
+  return (i < 0) ? E_DOES_NOT_EXIST : s_persist[i].size;
+}
+
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size) {
+  int i = persist_find(key);
+  COUNT(persist_reads, 1);
+  if (i < 0) return E_DOES_NOT_EXIST;
+  int size = ((int)buffer_size < s_persist[i].size) ? (int)buffer_size : s_persist[i].size;
+  memcpy(buffer, s_persist[i].data, size);
+  return size;
+}
+
+int32_t persist_read_int(uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+bool persist_read_bool(uint32_t key) {
+  return persist_read_int(key) != 0;
+}
+
+int persist_write_data(uint32_t key, const void *data, size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) size = PERSIST_DATA_MAX_LENGTH;
+  int i = persist_find(key);
+  if (i < 0) {
+    if (s_persist_count == MAX_PERSIST_KEYS) return E_OUT_OF_STORAGE;
+    i = s_persist_count++;
+    s_persist[i].key = key;
+  }
+  memcpy(s_persist[i].data, data, size);
+  s_persist[i].size = size;
+  COUNT(persist_writes, 1);
+  return size;
+}
+
+int persist_write_int(uint32_t key, int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_bool(uint32_t key, bool value) {
+  int32_t int_value = value;
+  return persist_write_data(key, &int_value, sizeof(int_value));
+}
+
+int persist_delete(uint32_t key) {
+  int i = persist_find(key);
+  if (i < 0) return E_DOES_NOT_EXIST;
+  s_persist[i] = s_persist[--s_persist_count];
+  return S_SUCCESS;
+}
+
+// Vibes and backlight
+
+// (segments counted the same as the ledger does)
+static void count_vibe(uint16_t segments) {
+  s_launch_vibed = true;
+  s_counts.vibe_segments += segments;
+}
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) { count_vibe(pattern.num_segments); }
+void vibes_short_pulse(void) { count_vibe(1); }
+void vibes_long_pulse(void) { count_vibe(1); }
+void vibes_double_pulse(void) { count_vibe(3); }
+void vibes_cancel(void) {}
+void light_enable_interaction(void) {}
+
+// Accelerometer
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler) {
+  s_accel_subscribed = true;
+}
+
+void accel_data_service_unsubscribe(void) {
+  s_accel_subscribed = false;
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate) { return 0; }
+
+// Background worker
+
+AppWorkerResult app_worker_launch(void) {
+  if (s_worker_running) return APP_WORKER_RESULT_ALREADY_RUNNING;
+  if (s_worker_ask_confirmation) return APP_WORKER_RESULT_ASKING_CONFIRMATION;
+  s_worker_running = true;
+  return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult app_worker_kill(void) {
+  if (!s_worker_running) return APP_WORKER_RESULT_NOT_RUNNING;
+  s_worker_running = false;
+  return APP_WORKER_RESULT_SUCCESS;
+}
+
+bool app_worker_is_running(void) {
+  return s_worker_running;
+}
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler) {
+  s_worker_handler = handler;
+  return true;
+}
+
+bool app_worker_message_unsubscribe(void) {
+  s_worker_handler = NULL;
+  return true;
+}
+
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data) {}
+
+// App messages (never connected to a phone)
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) { return APP_MSG_BUSY; }
+AppMessageResult app_message_outbox_send(void) { return APP_MSG_BUSY; }
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data,
+                                 const uint16_t size) { return DICT_NOT_ENOUGH_STORAGE; }
+
+// App glance
+
+void app_glance_reload(AppGlanceReloadCallback callback, void *context) {}
+AppGlanceResult app_glance_add_slice(AppGlanceReloadSession *session, AppGlanceSlice slice) {
+  return APP_GLANCE_RESULT_SUCCESS;
+}
+
+// Buttons and windows
+
+// (the recognizer is just the button)
+ButtonId click_recognizer_get_button_id(ClickRecognizerRef recognizer) {
+  return (ButtonId)(intptr_t)recognizer;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  s_click_handlers[button_id] = handler;
+}
+
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout,
+                                  bool last_click_only, ClickHandler handler) {
+  s_multi_click_handlers[button_id] = handler;
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler,
+                                 ClickHandler up_handler) {}
+
+void window_stack_pop_all(bool animated) {
+  fake_window_pop_all();
+}
+
+// Memory
+
+size_t heap_bytes_used(void) { return 0; }
+size_t heap_bytes_free(void) { return 24 * 1024; }
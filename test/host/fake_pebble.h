@@ -0,0 +1,62 @@
+#pragma once
+#include <pebble.h>
+
+// Controls for the fake Pebble services in fake_pebble.c
+
+// Sets the timezone as a POSIX TZ string (e.g. "GMT0BST,M3.5.0/1,M10.5.0"), so no tz database is needed
+void fake_set_timezone(const char *tz);
+// Sets the watch clock (UTC)
+void fake_set_time(time_t now);
+// Gets a UTC timestamp from a UTC date and time
+time_t fake_utc(int year, int month, int day, int hour, int minute);
+// Clears the persistent storage, wakeups, timers and worker, like a fresh install
+void fake_reset(void);
+
+// The app under test, which the fakes launch for wakeups and worker events
+void fake_set_app(void (*init)(void), void (*deinit)(void));
+// Launches the app (giving the launch reason and wakeup event it reads)
+void fake_launch(AppLaunchReason reason, WakeupId wakeup_id, int32_t cookie);
+// Stops the app as if it crashed or was forced to exit: its timers and subscriptions go, but the
+// wakeups, storage and worker stay
+void fake_kill(void);
+// Closes the app normally
+void fake_exit(void);
+bool fake_app_running(void);
+// Runs the clock forward, firing timers while the app runs and wakeups (launching the app for them
+// if it isn't running). Stops after the first wakeup if 'until_wakeup'. Returns whether a wakeup fired
+bool fake_run(uint32_t ms, bool until_wakeup);
+// Number of wakeups scheduled with the cookies in the mask (bit 'cookie' set for each)
+uint8_t fake_wakeup_count(uint32_t cookie_mask);
+
+// Presses a button, going to the handlers the app subscribed with its click config provider
+void fake_click(ButtonId button_id);
+void fake_double_click(ButtonId button_id);
+// The worker detects an event: it saves it for the app, sends it if the app is running and else
+// launches the app (like the real worker). Does nothing if the worker isn't running
+void fake_worker_event(uint16_t type);
+bool fake_worker_running(void);
+// Makes launching the worker ask the user to confirm (as when another app's worker is running),
+// so it doesn't start until confirmed
+void fake_worker_ask_confirmation(bool ask);
+// The user confirms: the worker starts and, like the real one, tells the app it is monitoring
+void fake_worker_confirm(void);
+bool fake_accel_subscribed(void);
+
+// Windows pushed by the stand-in windows (the app exits when it has none left after an event)
+void fake_window_push(void);
+void fake_window_pop_all(void);
+
+// Counts of everything that uses power, for reporting per simulated night
+typedef struct FakeCounts {
+  uint16_t launches;
+  uint16_t wakeups;
+  uint16_t timers;
+  uint16_t persist_reads;
+  uint16_t persist_writes;
+  uint16_t windows;
+  uint16_t vibe_segments;
+} FakeCounts;
+FakeCounts fake_counts(void);
+void fake_clear_counts(void);
+// Counts from the last launch until its first vibration (all of the launch if it didn't vibrate)
+FakeCounts fake_counts_before_vibe(void);
@@ -0,0 +1,122 @@
+// Checks the movement detectors the app and the worker share (src/c/movement.c)
+// Run with: sh test/host/run.sh
+
+#include "movement.h"
+#include "workermsg.h"
+#include "history.h"
+#include "fake_pebble.h"
+#include "test_runner.h"
+
+// Number of readings in each accel callback (as both the app and worker subscribe)
+#define SAMPLES 5
+// Movement that triggers the Smart Alarm at medium sensitivity (MOVEMENT_THRESHOLD_MID in gentlewake.c)
+#define THRESHOLD 15000
+
+static void fill(AccelData *data, int16_t x, int16_t y, int16_t z) {
+  for (uint8_t i = 0; i < SAMPLES; i++)
+    data[i] = (AccelData){ .x = x, .y = y, .z = z };
+}
+
+static void still_is_not_stirring(void) {
+  StirringDetector detector;
+  AccelData data[SAMPLES];
+  stirring_reset(&detector, 0);
+  
+  // Small changes like breathing, for a minute
+  int movement = 0;
+  for (uint16_t i = 0; i < 120; i++) {
+    fill(data, 10 + (i % 2) * 20, -1000, 50);
+    movement = stirring_add(&detector, data, SAMPLES);
+  }
+  CHECK_EQ(movement, 0);
+}
+
+static void tossing_and_turning_is_stirring(void) {
+  StirringDetector detector;
+  AccelData data[SAMPLES];
+  stirring_reset(&detector, 0);
+  
+  // Large changes in every reading build up until over the threshold
+  int movement = 0;
+  uint16_t callbacks = 0;
+  while (movement <= THRESHOLD && callbacks < 100) {
+    for (uint8_t i = 0; i < SAMPLES; i++)
+      data[i] = (AccelData){ .x = (i % 2) ? 300 : -300, .y = -800, .z = 100 };
+    movement = stirring_add(&detector, data, SAMPLES);
+    callbacks++;
+  }
+  CHECK(movement > THRESHOLD);
+  CHECK(callbacks > 1);
+  
+  // Readings taken while vibrating are ignored
+  stirring_reset(&detector, 0);
+  for (uint8_t i = 0; i < SAMPLES; i++)
+    data[i] = (AccelData){ .x = (i % 2) ? 300 : -300, .y = -800, .z = 100, .did_vibrate = i > 0 };
+  CHECK_EQ(stirring_add(&detector, data, SAMPLES), 0);
+}
+
+// Movement builds up in one epoch and dies away in the next, and each epoch's peak is saved once, as
+// the next epoch starts, then added to the night's history record
+static void epochs_saved_once_each(void) {
+  fake_reset();
+  time_t alarm_time = fake_utc(2021, 6, 1, 6, 0);
+  history_start(alarm_time);
+  StirringDetector detector;
+  stirring_reset(&detector, alarm_time);
+  fake_clear_counts();
+  
+  // A burst of movement at 05:41 (in epoch 8), then readings that don't change once a minute until the
+  // alarm, so the movement goes down by REST_MOVEMENT each time
+  AccelData data[SAMPLES];
+  for (uint8_t i = 0; i < SAMPLES; i++)
+    data[i] = (AccelData){ .x = (i % 2) ? 300 : -300, .y = -800, .z = 100 };
+  fake_set_time(alarm_time - (19 * 60));
+  CHECK_EQ(stirring_add(&detector, data, SAMPLES), 2100);
+  fill(data, -300, -800, 100);
+  for (uint8_t minute = 42; minute < 60; minute++) {
+    fake_set_time(alarm_time - ((60 - minute) * 60));
+    stirring_add(&detector, data, SAMPLES);
+  }
+  stirring_save(&detector);
+  CHECK_EQ(fake_counts().persist_writes, 2);
+  
+  history_append();
+  HistoryRecord record;
+  CHECK(history_read(0, &record));
+  CHECK_TIME(record.alarm_time, alarm_time);
+  for (uint8_t epoch = 0; epoch < HISTORY_EPOCHS; epoch++)
+    CHECK_EQ(record.movement[epoch], epoch == 8 ? 2100 >> 8 : epoch == 9 ? 600 >> 8 : 0);
+  CHECK(!persist_exists(MOVEMENT_EPOCHS_KEY));
+}
+
+// Swings the arm back and forth (arm vertical, with the y reading changing side)
+static uint8_t swing(ArmSwingDetector *detector) {
+  AccelData data[SAMPLES];
+  fill(data, 900, -100, 0);
+  arm_swing_add(detector, data, SAMPLES);
+  fill(data, 900, 800, 0);
+  return arm_swing_add(detector, data, SAMPLES);
+}
+
+static void arm_swings_count(void) {
+  fake_set_time(fake_utc(2021, 6, 1, 7, 5));
+  ArmSwingDetector detector;
+  arm_swing_reset(&detector);
+  
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < GOOB_ARM_SWINGS; i++)
+    count = swing(&detector);
+  CHECK_EQ(count, GOOB_ARM_SWINGS);
+  
+  // More than 2 seconds without a swing starts the count again
+  fake_set_time(time(NULL) + 3);
+  CHECK_EQ(swing(&detector), 1);
+}
+
+int main(void) {
+  run_test("still is not stirring", still_is_not_stirring);
+  run_test("tossing and turning is stirring", tossing_and_turning_is_stirring);
+  run_test("epochs saved once each", epochs_saved_once_each);
+  run_test("arm swings count", arm_swings_count);
+  return test_summary();
+}
@@ -0,0 +1,179 @@
+#pragma once
+// Stand-in for the Pebble SDK header so the app's non-UI code can be compiled and tested on the desktop.
+// Only declares what the modules built into the host tests use (see run.sh); the services are faked
+// in fake_pebble.c and the app's windows are stubbed out in app_stubs.c
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+// Build as a black & white, rectangular SDK 3 watch
+#define PBL_SDK_3 1
+#define PBL_BW 1
+#define PBL_RECT 1
+#define PBL_IF_RECT_ELSE(rect, round) (rect)
+#define PBL_IF_ROUND_ELSE(round, rect) (rect)
+#define COLOR_FALLBACK(color, bw) (bw)
+#define ACTION_BAR_WIDTH 30
+
+#define ARRAY_LENGTH(array) (sizeof((array)) / sizeof((array)[0]))
+#define SECONDS_PER_DAY 86400
+
+// Logging
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200
+} AppLogLevel;
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...);
+#define APP_LOG(level, fmt, args...) app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+// Status codes
+#define S_SUCCESS 0
+#define E_INVALID_ARGUMENT (-2)
+#define E_DOES_NOT_EXIST (-4)
+#define E_OUT_OF_STORAGE (-6)
+#define E_OUT_OF_RESOURCES (-7)
+#define E_RANGE (-8)
+
+// Graphics and windows (only as far as the app's headers need them)
+typedef struct { int16_t x, y; } GPoint;
+typedef struct { int16_t w, h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+typedef union { uint8_t argb; } GColor;
+typedef struct Layer Layer;
+typedef struct Window Window;
+typedef struct GBitmap GBitmap;
+typedef struct GContext GContext;
+typedef struct ActionBarLayer ActionBarLayer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+void window_stack_pop_all(bool animated);
+
+// Buttons
+typedef enum { BUTTON_ID_BACK, BUTTON_ID_UP, BUTTON_ID_SELECT, BUTTON_ID_DOWN, NUM_BUTTONS } ButtonId;
+typedef void* ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+ButtonId click_recognizer_get_button_id(ClickRecognizerRef recognizer);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout,
+                                  bool last_click_only, ClickHandler handler);
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler,
+                                 ClickHandler up_handler);
+
+// Time
+typedef enum { TODAY = 0, SUNDAY, MONDAY, TUESDAY, WEDNESDAY, THURSDAY, FRIDAY, SATURDAY } WeekDay;
+typedef enum { SECOND_UNIT = 1, MINUTE_UNIT = 2, HOUR_UNIT = 4, DAY_UNIT = 8 } TimeUnits;
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms);
+time_t clock_to_timestamp(WeekDay day, int hour, int minute);
+bool clock_is_24h_style(void);
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+// Timers
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+// Wakeups and launching
+typedef int32_t WakeupId;
+typedef void (*WakeupHandler)(WakeupId wakeup_id, int32_t cookie);
+typedef enum {
+  APP_LAUNCH_SYSTEM,
+  APP_LAUNCH_USER,
+  APP_LAUNCH_PHONE,
+  APP_LAUNCH_WAKEUP,
+  APP_LAUNCH_WORKER,
+  APP_LAUNCH_QUICK_LAUNCH,
+  APP_LAUNCH_TIMELINE_ACTION,
+  APP_LAUNCH_SMARTSTRAP
+} AppLaunchReason;
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed);
+void wakeup_cancel(WakeupId wakeup_id);
+void wakeup_cancel_all(void);
+bool wakeup_query(WakeupId wakeup_id, time_t *timestamp);
+void wakeup_service_subscribe(WakeupHandler handler);
+void wakeup_get_launch_event(WakeupId *wakeup_id, int32_t *cookie);
+AppLaunchReason launch_reason(void);
+void app_event_loop(void);
+
+// Persistent storage
+#define PERSIST_DATA_MAX_LENGTH 256
+bool persist_exists(uint32_t key);
+int persist_get_size(uint32_t key);
+int32_t persist_read_int(uint32_t key);
+bool persist_read_bool(uint32_t key);
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size);
+int persist_write_int(uint32_t key, int32_t value);
+int persist_write_bool(uint32_t key, bool value);
+int persist_write_data(uint32_t key, const void *data, size_t size);
+int persist_delete(uint32_t key);
+
+// Vibes and backlight
+typedef struct { const uint32_t *durations; uint32_t num_segments; } VibePattern;
+void vibes_enqueue_custom_pattern(VibePattern pattern);
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+void vibes_cancel(void);
+void light_enable_interaction(void);
+
+// Accelerometer
+typedef struct { int16_t x, y, z; bool did_vibrate; uint64_t timestamp; } AccelData;
+typedef void (*AccelDataHandler)(AccelData *data, uint32_t num_samples);
+typedef enum { ACCEL_SAMPLING_10HZ = 10, ACCEL_SAMPLING_25HZ = 25 } AccelSamplingRate;
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler);
+void accel_data_service_unsubscribe(void);
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+
+// Background worker
+typedef struct { uint16_t data0; uint16_t data1; uint16_t data2; } AppWorkerMessage;
+typedef void (*AppWorkerMessageHandler)(uint16_t type, AppWorkerMessage *data);
+typedef enum {
+  APP_WORKER_RESULT_SUCCESS = 0,
+  APP_WORKER_RESULT_NO_WORKER = 1,
+  APP_WORKER_RESULT_DIFFERENT_APP = 2,
+  APP_WORKER_RESULT_NOT_RUNNING = 3,
+  APP_WORKER_RESULT_ALREADY_RUNNING = 4,
+  APP_WORKER_RESULT_ASKING_CONFIRMATION = 5
+} AppWorkerResult;
+AppWorkerResult app_worker_launch(void);
+AppWorkerResult app_worker_kill(void);
+bool app_worker_is_running(void);
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+
+// App messages (for sending the ledger to the phone)
+typedef struct DictionaryIterator DictionaryIterator;
+typedef enum { APP_MSG_OK = 0, APP_MSG_BUSY = 64 } AppMessageResult;
+typedef enum { DICT_OK = 0, DICT_NOT_ENOUGH_STORAGE = 2 } DictionaryResult;
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data,
+                                 const uint16_t size);
+#define MESSAGE_KEY_LedgerData 10002
+
+// App glance
+typedef struct AppGlanceReloadSession AppGlanceReloadSession;
+typedef struct {
+  struct { uint32_t icon; const char *subtitle_template_string; } layout;
+  time_t expiration_time;
+} AppGlanceSlice;
+typedef enum { APP_GLANCE_RESULT_SUCCESS = 0 } AppGlanceResult;
+#define APP_GLANCE_SLICE_NO_EXPIRATION ((time_t)0)
+#define APP_GLANCE_SLICE_DEFAULT_ICON ((uint32_t)0)
+typedef void (*AppGlanceReloadCallback)(AppGlanceReloadSession *session, size_t limit, void *context);
+void app_glance_reload(AppGlanceReloadCallback callback, void *context);
+AppGlanceResult app_glance_add_slice(AppGlanceReloadSession *session, AppGlanceSlice slice);
+
+// Memory
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Builds and runs the host tests: each test/host/*_test.c is compiled with the app's non-UI sources
+# against the stand-in pebble.h here, so they run on the desktop without the Pebble SDK
+# Run with: sh test/host/run.sh (CC picks the compiler, the executables go in build/host_test)
+cd "$(dirname "$0")/../.." || exit 1
+CC=${CC:-cc}
+OUT=build/host_test
+SOURCES="test/host/test_runner.c test/host/fake_pebble.c test/host/app_stubs.c src/c/common.c src/c/ledger.c src/c/history.c src/c/movement.c"
+
+mkdir -p $OUT
+failed=0
+for test in test/host/*_test.c; do
+  name=$(basename $test .c)
+  echo "== $name"
+  if $CC -std=gnu99 -O1 -Itest/host -Isrc/c -o $OUT/$name $test $SOURCES; then
+    $OUT/$name || failed=$((failed + 1))
+  else
+    failed=$((failed + 1))
+  fi
+done
+
+[ $failed -eq 0 ] || echo "$failed host test(s) failed"
+exit $failed
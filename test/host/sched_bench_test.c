@@ -0,0 +1,104 @@
+// Times the alarm scheduling functions over the same random configurations, to compare changes to
+// them (the times are for this machine, so only the differences between runs mean anything)
+// Run with: sh test/host/run.sh
+
+// Built with the main program unit, so its statics can be set up directly
+#define main gentlewake_main
+#include "../../src/c/gentlewake.c"
+#undef main
+
+#include "fake_pebble.h"
+#include "test_runner.h"
+
+#define SCHED_BENCH_CONFIGS 100000
+
+typedef enum BenchFunc {
+  BF_Config,
+  BF_GetNextAlarm,
+  BF_AlarmToTimestamp,
+  BF_GenInfoStr,
+  BF_AlarmWakeup,
+  BF_Max
+} BenchFunc;
+
+static const char *s_bench_names[BF_Max] = { "config", "get_next_alarm", "alarm_to_timestamp", "gen_info_str",
+                                             "get_alarm_wakeup" };
+
+static uint32_t s_seed;
+
+// Simple repeatable random number generator so every function gets the same configurations
+static uint32_t sched_rand(uint32_t max) {
+  s_seed = s_seed * 1103515245 + 12345;
+  return (s_seed >> 16) % max;
+}
+
+static double bench_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+// Sets up random alarms, settings and state
+static void bench_random_config(time_t today) {
+  for (uint8_t d = 0; d < 7; d++) {
+    s_alarms[d].enabled = sched_rand(2);
+    s_alarms[d].hour = sched_rand(24);
+    s_alarms[d].minute = sched_rand(60);
+  }
+  s_settings.one_time_alarm.enabled = sched_rand(4) == 0;
+  s_settings.one_time_alarm.hour = sched_rand(24);
+  s_settings.one_time_alarm.minute = sched_rand(60);
+  s_settings.smart_alarm = sched_rand(2);
+  s_settings.monitor_period = 5 + (sched_rand(12) * 5);
+  s_settings.goob_mode = sched_rand(3);
+  s_settings.goob_monitor_period = 5 + (sched_rand(6) * 5);
+  s_skip_until = sched_rand(3) == 0 ? today + (sched_rand(14) * SECONDS_PER_DAY) : 0;
+  s_state.last_reset_day = sched_rand(2) ? strip_time(time(NULL)) : 0;
+  s_state.snoozing = false;
+  s_state.monitoring = false;
+}
+
+// Runs one function over all the configurations and returns the total time taken
+// (each function's time includes the functions it depends on, and all include setting up the configurations)
+static double bench_func(BenchFunc func) {
+  time_t curr_time = time(NULL);
+  time_t today = strip_time(curr_time + get_UTC_offset(NULL));
+  uint8_t wakeup_reason;
+  s_seed = 1;
+
+  double start = bench_ms();
+  for (uint32_t i = 0; i < SCHED_BENCH_CONFIGS; i++) {
+    bench_random_config(today);
+    int8_t next_alarm = (func == BF_Config) ? NEXT_ALARM_NONE : get_next_alarm(curr_time);
+    bool has_time = next_alarm != NEXT_ALARM_NONE;
+
+    switch (func) {
+      case BF_AlarmToTimestamp:
+        if (has_time) alarm_to_timestamp(next_alarm, curr_time);
+        break;
+      case BF_GenInfoStr:
+        gen_info_str(next_alarm);
+        break;
+      case BF_AlarmWakeup:
+        if (has_time) get_alarm_wakeup(alarm_to_timestamp(next_alarm, curr_time), curr_time, &wakeup_reason);
+        break;
+      default:
+        break;
+    }
+  }
+  return bench_ms() - start;
+}
+
+static void sched_bench(void) {
+  fake_set_timezone("GMT0BST,M3.5.0/1,M10.5.0");
+  fake_set_time(fake_utc(2021, 6, 1, 12, 0));
+  s_alarms_on = true;
+
+  for (BenchFunc func = 0; func < BF_Max; func++)
+    printf("  %s: %d calls, %.1f ms\n", s_bench_names[func], SCHED_BENCH_CONFIGS, bench_func(func));
+}
+
+int main(void) {
+  run_test("scheduling benchmark", sched_bench);
+  return test_summary();
+}
@@ -0,0 +1,246 @@
+// Checks the alarm scheduling against a slow minute-by-minute search, over random configurations at
+// random times (often around midnight and the clock changes) in a few timezones
+// Run with: sh test/host/run.sh (set SCHED_CHECK_SEED to repeat a run with a logged seed)
+
+// Built with the main program unit, so its statics can be set up directly
+#define main gentlewake_main
+#include "../../src/c/gentlewake.c"
+#undef main
+
+#include "fake_pebble.h"
+#include "test_runner.h"
+
+#define SCHED_CHECK_CASES 2000
+#define SCHED_CHECK_MAX_SKIP_DAYS 10
+// Number of days from the start that 'now' is picked from
+#define SCHED_CHECK_DAYS 366
+#define SCHED_CHECK_MAX_CHANGES 8
+// Failures shown per timezone (each is shrunk first, which is slow)
+#define SCHED_CHECK_MAX_SHOWN 5
+
+static const char *s_timezones[] = {
+  "UTC0",
+  "GMT0BST,M3.5.0/1,M10.5.0",                      // London
+  "EST5EDT,M3.2.0,M11.1.0",                        // New York
+  "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45",  // Chatham Islands
+  "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0",          // Lord Howe Island (30 minute change)
+  "<-03>3<-02>,M11.1.0/0,M2.3.0/0"                 // Sao Paulo when it changed at midnight
+};
+
+static uint32_t s_seed;
+
+// Simple repeatable random number generator so a seed always gives the same run
+static uint32_t sched_rand(uint32_t max) {
+  s_seed = s_seed * 1103515245 + 12345;
+  return (s_seed >> 16) % max;
+}
+
+// Gets a local day number for a UTC timestamp
+static int32_t local_day(time_t utc) {
+  return (utc + get_UTC_offset(localtime(&utc))) / SECONDS_PER_DAY;
+}
+
+// Deliberately simple next alarm search: steps forward one minute at a time and an alarm goes off
+// the first minute each day that the local time reaches the alarm time (so when the clocks go
+// forward over it, and only once when they go back over it). Returns 0 if there is no alarm
+static time_t oracle_next_alarm(time_t now) {
+  if (!s_alarms_on) return 0;
+
+  int32_t today = local_day(now);
+  int32_t skip_day = s_skip_until / SECONDS_PER_DAY;
+  bool reset_today = strip_time(now) == s_state.last_reset_day;
+  int32_t rung_day = 0;
+  time_t end = now + ((SCHED_CHECK_MAX_SKIP_DAYS + 9) * SECONDS_PER_DAY);
+
+  // Start from the day before so an alarm that already went off today is seen
+  for (time_t t = now - (now % 60) - SECONDS_PER_DAY; t < end; t += 60) {
+    int32_t day = local_day(t);
+    if (day <= rung_day) continue;
+
+    struct tm *lt = localtime(&t);
+    // The one-time alarm goes off at the same time every day, ignoring skipping and resets
+    alarm *a = s_settings.one_time_alarm.enabled ? &s_settings.one_time_alarm : &s_alarms[lt->tm_wday];
+    if (!a->enabled || (lt->tm_hour * 60) + lt->tm_min < (a->hour * 60) + a->minute) continue;
+
+    rung_day = day;
+    if (t > now && (s_settings.one_time_alarm.enabled ||
+                    (!(reset_today && day == today) && (s_skip_until == 0 || day >= skip_day))))
+      return t;
+  }
+  return 0;
+}
+
+// Gets the next alarm time from the real scheduling (returns 0 if there is no alarm)
+static time_t sched_next_alarm(time_t now) {
+  int8_t next_alarm = get_next_alarm(now);
+  return next_alarm == NEXT_ALARM_NONE ? 0 : alarm_to_timestamp(next_alarm, now);
+}
+
+static bool sched_check_fails(time_t now) {
+  return sched_next_alarm(now) != oracle_next_alarm(now);
+}
+
+// Finds when the UTC offset changes (like for daylight savings) over the days 'now' is picked from
+static uint8_t find_offset_changes(time_t start, time_t *changes) {
+  uint8_t count = 0;
+  time_t prev = start;
+  time_t prev_offset = get_UTC_offset(localtime(&prev));
+
+  for (uint16_t d = 1; d <= SCHED_CHECK_DAYS && count < SCHED_CHECK_MAX_CHANGES; d++) {
+    time_t t = start + (d * SECONDS_PER_DAY);
+    time_t offset = get_UTC_offset(localtime(&t));
+    if (offset != prev_offset) {
+      // Narrow it down to the minute
+      time_t lo = prev;
+      time_t hi = t;
+      while (hi - lo > 60) {
+        time_t mid = lo + (((hi - lo) / 120) * 60);
+        if (get_UTC_offset(localtime(&mid)) == offset)
+          hi = mid;
+        else
+          lo = mid;
+      }
+      changes[count++] = hi;
+      prev_offset = offset;
+    }
+    prev = t;
+  }
+  return count;
+}
+
+// Picks a random 'now': any time, within minutes of midnight, or within minutes or days of a
+// change of UTC offset (if there are any)
+static time_t check_random_now(time_t start, time_t *changes, uint8_t change_count) {
+  time_t day = start + (sched_rand(SCHED_CHECK_DAYS) * SECONDS_PER_DAY);
+
+  switch (sched_rand(change_count > 0 ? 4 : 2)) {
+    case 0:
+      return local_to_timestamp(day, 0, 0, 0) + sched_rand(10 * 60) - (5 * 60);
+    case 1:
+      return local_to_timestamp(day, 0, 0, 0) + (sched_rand(24 * 60) * 60) + sched_rand(60);
+    case 2:
+      return changes[sched_rand(change_count)] + sched_rand(20 * 60) - (10 * 60);
+    default:
+      // (days either side so the alarms on the days before and after get checked too)
+      return changes[sched_rand(change_count)] + (sched_rand(4 * 24 * 60) * 60) + sched_rand(60) -
+        (2 * SECONDS_PER_DAY);
+  }
+}
+
+// Sets up random alarms and state, with alarm times often within a couple of minutes of now
+// so that the 'is the alarm still to come today' comparisons get exercised
+static void check_random_config(time_t now) {
+  struct tm *now_t = localtime(&now);
+  uint16_t now_mins = now_t->tm_hour * 60 + now_t->tm_min;
+  time_t today = strip_time(now + get_UTC_offset(now_t));
+
+  for (uint8_t d = 0; d < 7; d++) {
+    s_alarms[d].enabled = sched_rand(2);
+    uint16_t mins = sched_rand(2) ? (now_mins + 1440 + sched_rand(5) - 2) % 1440 : sched_rand(1440);
+    s_alarms[d].hour = mins / 60;
+    s_alarms[d].minute = mins % 60;
+  }
+  s_alarms_on = sched_rand(8) != 0;
+  s_settings.one_time_alarm.enabled = sched_rand(4) == 0;
+  uint16_t mins = (now_mins + 1440 + sched_rand(5) - 2) % 1440;
+  s_settings.one_time_alarm.hour = mins / 60;
+  s_settings.one_time_alarm.minute = mins % 60;
+  s_skip_until = sched_rand(2) ? today + (sched_rand(SCHED_CHECK_MAX_SKIP_DAYS + 1) * SECONDS_PER_DAY) : 0;
+  s_state.last_reset_day = sched_rand(2) ? strip_time(now) : 0;
+}
+
+// Removes as much as possible from a failing configuration while it still fails, so the reported
+// configuration only has what is needed to show the problem
+static void shrink_failure(time_t now) {
+  bool shrunk = true;
+  while (shrunk) {
+    shrunk = false;
+    for (uint8_t d = 0; d < 7; d++) {
+      if (s_alarms[d].enabled) {
+        s_alarms[d].enabled = false;
+        if (sched_check_fails(now))
+          shrunk = true;
+        else
+          s_alarms[d].enabled = true;
+      }
+    }
+    if (s_settings.one_time_alarm.enabled) {
+      s_settings.one_time_alarm.enabled = false;
+      if (sched_check_fails(now))
+        shrunk = true;
+      else
+        s_settings.one_time_alarm.enabled = true;
+    }
+    if (s_skip_until != 0) {
+      time_t skip_until = s_skip_until;
+      s_skip_until = 0;
+      if (sched_check_fails(now))
+        shrunk = true;
+      else
+        s_skip_until = skip_until;
+    }
+    if (s_state.last_reset_day != 0) {
+      time_t last_reset_day = s_state.last_reset_day;
+      s_state.last_reset_day = 0;
+      if (sched_check_fails(now))
+        shrunk = true;
+      else
+        s_state.last_reset_day = last_reset_day;
+    }
+  }
+}
+
+static void report_failure(uint16_t test_case, time_t now) {
+  char alarms[7 * 8 + 1] = "";
+  for (uint8_t d = 0; d < 7; d++) {
+    if (s_alarms[d].enabled)
+      snprintf(alarms + strlen(alarms), sizeof(alarms) - strlen(alarms), " %d=%d:%02d", d, s_alarms[d].hour,
+               s_alarms[d].minute);
+  }
+  test_fail(__FILE__, __LINE__, "case %d, now %d: next alarm %d, expected %d (on %d, onetime %d %d:%02d, "
+            "skip %d, reset %d, alarms%s)", test_case, (int)now, (int)sched_next_alarm(now),
+            (int)oracle_next_alarm(now), s_alarms_on, s_settings.one_time_alarm.enabled,
+            s_settings.one_time_alarm.hour, s_settings.one_time_alarm.minute, (int)s_skip_until,
+            (int)s_state.last_reset_day, alarms);
+}
+
+static uint32_t s_run_seed;
+static const char *s_timezone;
+
+// Compares the scheduling against the minute-by-minute search in one timezone, and reports the first
+// few failures after shrinking them. Times are picked from the year after the start of 2021
+static void check_timezone(void) {
+  fake_set_timezone(s_timezone);
+  time_t start = fake_utc(2021, 1, 1, 0, 0);
+  time_t changes[SCHED_CHECK_MAX_CHANGES];
+  uint8_t change_count = find_offset_changes(start, changes);
+  uint16_t failures = 0;
+
+  s_state.snoozing = false;
+  s_state.monitoring = false;
+  s_seed = s_run_seed;
+
+  for (uint16_t i = 0; i < SCHED_CHECK_CASES; i++) {
+    time_t now = check_random_now(start, changes, change_count);
+    check_random_config(now);
+    if (sched_check_fails(now)) {
+      if (++failures > SCHED_CHECK_MAX_SHOWN) continue;
+      shrink_failure(now);
+      report_failure(i, now);
+    }
+  }
+  if (failures > SCHED_CHECK_MAX_SHOWN)
+    test_fail(__FILE__, __LINE__, "%d failures in all (seed %u)", failures, s_run_seed);
+}
+
+int main(void) {
+  const char *seed = getenv("SCHED_CHECK_SEED");
+  s_run_seed = seed ? strtoul(seed, NULL, 10) : 1;
+  printf("seed %u\n", s_run_seed);
+
+  for (uint8_t i = 0; i < ARRAY_LENGTH(s_timezones); i++) {
+    s_timezone = s_timezones[i];
+    run_test(s_timezone, check_timezone);
+  }
+  return test_summary();
+}
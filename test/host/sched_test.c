@@ -0,0 +1,213 @@
+// Checks the alarm scheduling (get_next_alarm and alarm_to_timestamp) for skip dates and clock changes
+// Run with: sh test/host/run.sh
+
+// Built with the main program unit, so its statics can be set up directly
+#define main gentlewake_main
+#include "../../src/c/gentlewake.c"
+#undef main
+
+#include "fake_pebble.h"
+#include "test_runner.h"
+
+#define LONDON "GMT0BST,M3.5.0/1,M10.5.0"
+#define NEW_YORK "EST5EDT,M3.2.0,M11.1.0"
+#define CHATHAM "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45"
+// Sao Paulo used to change its clocks at midnight
+#define SAO_PAULO "<-03>3<-02>,M11.1.0/0,M2.3.0/0"
+
+// Starts each test with all alarms off and nothing skipped
+static void setup(const char *tz, time_t now) {
+  fake_set_timezone(tz);
+  fake_set_time(now);
+  memset(s_alarms, 0, sizeof(s_alarms));
+  memset(&s_state, 0, sizeof(s_state));
+  s_settings.one_time_alarm.enabled = false;
+  s_alarms_on = true;
+  s_skip_until = 0;
+}
+
+static void set_alarm(AlarmDay day, uint8_t hour, uint8_t minute) {
+  s_alarms[day] = (alarm){ true, hour, minute };
+}
+
+// The 'skip until' date as set by the skip window (local midnight, as seconds since the epoch)
+static void set_skip_until(int year, int month, int day) {
+  s_skip_until = fake_utc(year, month, day, 0, 0);
+}
+
+// The next alarm time as the app shows and schedules it (0 for none)
+static time_t next_alarm_time(void) {
+  time_t now = time(NULL);
+  int8_t next_alarm = get_next_alarm(now);
+  return next_alarm == NEXT_ALARM_NONE ? 0 : alarm_to_timestamp(next_alarm, now);
+}
+
+static void test_later_today(void) {
+  setup(LONDON, fake_utc(2021, 6, 1, 5, 0)); // Tue 06:00 BST
+  set_alarm(A_TUESDAY, 7, 30);
+  set_alarm(A_WEDNESDAY, 6, 0);
+  CHECK_EQ(get_next_alarm(time(NULL)), A_TUESDAY);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 1, 6, 30));
+}
+
+static void test_passed_today(void) {
+  setup(LONDON, fake_utc(2021, 6, 1, 7, 0)); // Tue 08:00 BST
+  set_alarm(A_TUESDAY, 7, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 8, 6, 30));
+}
+
+static void test_reset_today(void) {
+  setup(LONDON, fake_utc(2021, 6, 1, 5, 0));
+  set_alarm(A_TUESDAY, 7, 30);
+  set_alarm(A_THURSDAY, 7, 30);
+  // Smart Alarm went off early, so today's alarm is done
+  s_state.last_reset_day = strip_time(time(NULL));
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 3, 6, 30));
+}
+
+static void test_one_time(void) {
+  setup(NEW_YORK, fake_utc(2021, 6, 1, 12, 0)); // Tue 08:00 EDT
+  set_alarm(A_TUESDAY, 9, 0);
+  s_settings.one_time_alarm = (alarm){ true, 7, 0 };
+  CHECK_EQ(get_next_alarm(time(NULL)), NEXT_ALARM_ONETIME);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 2, 11, 0));
+}
+
+static void test_alarms_off(void) {
+  setup(LONDON, fake_utc(2021, 6, 1, 5, 0));
+  set_alarm(A_TUESDAY, 7, 30);
+  s_alarms_on = false;
+  CHECK_EQ(get_next_alarm(time(NULL)), NEXT_ALARM_NONE);
+}
+
+static void test_skip_within_week(void) {
+  setup(LONDON, fake_utc(2021, 6, 1, 5, 0)); // Tue
+  set_alarm(A_TUESDAY, 7, 30);
+  set_alarm(A_FRIDAY, 7, 30);
+  set_skip_until(2021, 6, 3); // Thu
+  CHECK_EQ(get_next_alarm(time(NULL)), A_FRIDAY);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 4, 6, 30));
+}
+
+// Skipping past the only alarm day of the week must give the alarm after the skip date,
+// not no alarm at all
+static void test_skip_past_only_alarm(void) {
+  setup(LONDON, fake_utc(2021, 5, 31, 12, 0)); // Mon
+  set_alarm(A_TUESDAY, 7, 0);
+  set_skip_until(2021, 6, 3); // Thu
+  CHECK_EQ(get_next_alarm(time(NULL)), NEXT_ALARM_SKIPWEEK);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 8, 6, 0));
+}
+
+// Skipping with no alarms on is still no alarm
+static void test_skip_no_alarms(void) {
+  setup(LONDON, fake_utc(2021, 5, 31, 12, 0));
+  set_skip_until(2021, 6, 14);
+  CHECK_EQ(get_next_alarm(time(NULL)), NEXT_ALARM_NONE);
+}
+
+static void test_skip_weeks(void) {
+  setup(NEW_YORK, fake_utc(2021, 6, 1, 12, 0)); // Tue
+  set_alarm(A_MONDAY, 6, 15);
+  set_alarm(A_WEDNESDAY, 6, 15);
+  set_skip_until(2021, 6, 16); // Wed, 2 weeks on
+  CHECK_EQ(get_next_alarm(time(NULL)), NEXT_ALARM_SKIPWEEK);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 6, 16, 10, 15));
+}
+
+// The skip date is a local date, so it must not be compared as a UTC date when the clocks
+// change in between (London is on UTC until the end of March)
+static void test_skip_date_across_dst(void) {
+  setup(LONDON, fake_utc(2021, 3, 25, 12, 0)); // Thu GMT
+  set_alarm(A_MONDAY, 7, 0);
+  set_skip_until(2021, 3, 29); // Mon BST
+  CHECK_EQ(get_next_alarm(time(NULL)), A_MONDAY);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 3, 29, 6, 0));
+}
+
+// The alarm after a skip of over a week is in the UTC offset of the skip date, not of today
+static void test_skip_week_across_dst(void) {
+  setup(LONDON, fake_utc(2021, 3, 18, 12, 0)); // Thu GMT
+  set_alarm(A_MONDAY, 7, 0);
+  set_skip_until(2021, 3, 29); // Mon BST
+  CHECK_EQ(get_next_alarm(time(NULL)), NEXT_ALARM_SKIPWEEK);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 3, 29, 6, 0));
+
+  setup(NEW_YORK, fake_utc(2021, 10, 28, 12, 0)); // Thu EDT
+  set_alarm(A_MONDAY, 7, 0);
+  set_skip_until(2021, 11, 8); // Mon EST
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 11, 8, 12, 0));
+}
+
+static void test_alarm_after_dst(void) {
+  setup(NEW_YORK, fake_utc(2021, 3, 12, 17, 0)); // Fri EST
+  set_alarm(A_MONDAY, 6, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 3, 15, 10, 30)); // EDT
+
+  setup(CHATHAM, fake_utc(2021, 9, 23, 0, 0)); // Thu +1245
+  set_alarm(A_MONDAY, 6, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 9, 26, 16, 45)); // +1345
+}
+
+// An alarm in the hour skipped by the clocks going forward goes off when they go forward
+static void test_skipped_time(void) {
+  setup(NEW_YORK, fake_utc(2021, 3, 13, 17, 0)); // Sat EST
+  set_alarm(A_SUNDAY, 2, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 3, 14, 7, 0)); // 03:00 EDT
+
+  setup(SAO_PAULO, fake_utc(2018, 11, 3, 15, 0)); // Sat -03
+  set_alarm(A_SUNDAY, 0, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2018, 11, 4, 3, 0)); // 01:00 -02
+}
+
+// An alarm in the hour repeated by the clocks going back goes off the first time round
+static void test_repeated_time(void) {
+  setup(LONDON, fake_utc(2021, 10, 30, 12, 0)); // Sat BST
+  set_alarm(A_SUNDAY, 1, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 10, 31, 0, 30)); // 01:30 BST
+
+  // Once it has gone off (at 01:30 BST), the repeat at 01:30 GMT is not another alarm
+  setup(LONDON, fake_utc(2021, 10, 31, 0, 31));
+  set_alarm(A_SUNDAY, 1, 30);
+  CHECK_TIME(next_alarm_time(), fake_utc(2021, 11, 7, 1, 30));
+}
+
+// The first minute of a day that starts with the clocks going forward is still that day
+static void test_midnight_dst(void) {
+  setup(SAO_PAULO, fake_utc(2018, 11, 3, 15, 0)); // Sat -03
+  set_alarm(A_SUNDAY, 7, 0);
+  set_alarm(A_MONDAY, 7, 0);
+  set_skip_until(2018, 11, 5); // Mon
+  CHECK_EQ(get_next_alarm(time(NULL)), A_MONDAY);
+  CHECK_TIME(next_alarm_time(), fake_utc(2018, 11, 5, 9, 0));
+}
+
+static void test_local_to_timestamp(void) {
+  fake_set_timezone(CHATHAM);
+  time_t now = fake_utc(2021, 4, 2, 12, 0); // Sat 01:45 +1345
+  CHECK_TIME(local_to_timestamp(now, 0, 23, 0), fake_utc(2021, 4, 3, 9, 15));
+  CHECK_TIME(local_to_timestamp(now, 1, 2, 0), fake_utc(2021, 4, 3, 12, 15)); // Sun 02:00 +1345
+  CHECK_TIME(local_to_timestamp(now, 1, 3, 0), fake_utc(2021, 4, 3, 13, 15)); // Sun 03:00 +1345
+  CHECK_TIME(local_to_timestamp(now, 1, 4, 0), fake_utc(2021, 4, 3, 15, 15)); // Sun 04:00 +1245
+  CHECK_TIME(local_to_timestamp(now, 7, 6, 0), fake_utc(2021, 4, 9, 17, 15));
+}
+
+int main(void) {
+  run_test("alarm later today", test_later_today);
+  run_test("alarm passed today", test_passed_today);
+  run_test("alarm reset today", test_reset_today);
+  run_test("one-time alarm", test_one_time);
+  run_test("alarms off", test_alarms_off);
+  run_test("skip within the week", test_skip_within_week);
+  run_test("skip past the only alarm", test_skip_past_only_alarm);
+  run_test("skip with no alarms", test_skip_no_alarms);
+  run_test("skip weeks", test_skip_weeks);
+  run_test("skip date across DST", test_skip_date_across_dst);
+  run_test("skip week across DST", test_skip_week_across_dst);
+  run_test("alarm after DST", test_alarm_after_dst);
+  run_test("time skipped by DST", test_skipped_time);
+  run_test("time repeated by DST", test_repeated_time);
+  run_test("DST at midnight", test_midnight_dst);
+  run_test("local_to_timestamp", test_local_to_timestamp);
+  return test_summary();
+}
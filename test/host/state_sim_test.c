@@ -0,0 +1,305 @@
+// Simulates weeks of alarm nights through the real app on a fake clock: scripted button presses,
+// worker events, crashes and relaunches, checking the alarm state after every step and reporting
+// what each night cost in wakeups, launches, timers, flash writes and vibrations, and how much an
+// alarm launch does before it vibrates
+// Run with: sh test/host/run.sh (set HOST_TEST_LOG to see every night's counts)
+
+// Built with the main program unit and its state checks (check_state is supplied below)
+#define STATE_CHECK
+#define main gentlewake_main
+#include "../../src/c/gentlewake.c"
+#undef main
+
+#include "fake_pebble.h"
+#include "test_runner.h"
+
+// Number of nights each script runs for
+#define SIM_NIGHTS 7
+// Longest wait for the next wakeup before giving up
+#define SIM_MAX_WAIT_MS (36 * 60 * 60 * 1000)
+#define ALARM_WAKEUP_REASONS ((1 << WAKEUP_REASON_ALARM) | (1 << WAKEUP_REASON_SNOOZE) | (1 << WAKEUP_REASON_MONITOR))
+
+typedef enum SimAction {
+  SA_Wait,        // Run the clock until the next wakeup has been handled
+  SA_Run,         // Run the clock for some minutes
+  SA_Click,       // Single click
+  SA_DoubleClick, // Double click
+  SA_Stirring,    // The worker detects stirring
+  SA_GooBStopped, // The worker detects the arm swings that stop the Get Out Of Bed alarm
+  SA_Kill,        // The app crashes or is forced to exit
+  SA_Launch,      // The user opens the app
+  SA_LoseWakeups, // The wakeups are lost while the app is closed (like when the watch is reset)
+  SA_AskWorker,   // Another app's worker is running, so launching the worker needs the user to confirm
+  SA_ConfirmWorker, // The user confirms the worker can start
+  SA_End
+} SimAction;
+
+typedef struct SimStep {
+  SimAction action;
+  uint16_t minutes;
+  AlarmMode mode;  // Mode expected afterwards (if the app is running)
+} SimStep;
+
+typedef struct SimScript {
+  const char *name;
+  bool smart_alarm;
+  GooBMode goob_mode;
+  SimStep steps[8];
+} SimScript;
+
+static const char *s_action_names[SA_End] = { "wait", "run", "click", "double click", "stirring",
+                                              "GooB stopped", "kill", "launch",
+                                              "lose wakeups", "ask worker", "confirm worker" };
+static const char *s_mode_names[AM_Max] = { "idle", "ringing", "GooB ringing", "snoozing",
+                                            "smart monitoring", "GooB monitoring" };
+
+// Each script is one night, repeated for SIM_NIGHTS nights
+static const SimScript s_scripts[] = {
+  { "snooze until reset", false, GM_Off, {
+    { SA_Wait, 0, AM_Ringing }, { SA_Run, 120, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "snooze then stop", false, GM_Off, {
+    { SA_Wait, 0, AM_Ringing }, { SA_Click, 0, AM_Snoozing }, { SA_Wait, 0, AM_Ringing },
+    { SA_DoubleClick, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "smart alarm stirring", true, GM_Off, {
+    { SA_Wait, 0, AM_SmartMonitoring }, { SA_Run, 10, AM_SmartMonitoring }, { SA_Stirring, 0, AM_Ringing },
+    { SA_Click, 0, AM_Snoozing }, { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } },
+  { "smart alarm sleeping", true, GM_Off, {
+    { SA_Wait, 0, AM_SmartMonitoring }, { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } },
+  { "GooB after alarm", false, GM_AfterAlarm, {
+    { SA_Wait, 0, AM_Ringing }, { SA_Click, 0, AM_Snoozing }, { SA_Wait, 0, AM_GooBRinging },
+    { SA_DoubleClick, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "GooB after stop", false, GM_AfterStop, {
+    { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_GooBMonitoring }, { SA_Run, 2, AM_GooBMonitoring },
+    { SA_GooBStopped, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "GooB after stop ringing", false, GM_AfterStop, {
+    { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_GooBMonitoring }, { SA_Wait, 0, AM_GooBRinging },
+    { SA_DoubleClick, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "crash while ringing", false, GM_Off, {
+    { SA_Wait, 0, AM_Ringing }, { SA_Kill, 0, AM_Idle }, { SA_Wait, 0, AM_Ringing },
+    { SA_DoubleClick, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "crash while snoozing", false, GM_Off, {
+    { SA_Wait, 0, AM_Ringing }, { SA_Click, 0, AM_Snoozing }, { SA_Kill, 0, AM_Idle }, { SA_Run, 2, AM_Idle },
+    { SA_Launch, 0, AM_Snoozing }, { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } },
+  { "crash while monitoring", true, GM_Off, {
+    { SA_Wait, 0, AM_SmartMonitoring }, { SA_Kill, 0, AM_Idle }, { SA_Launch, 0, AM_SmartMonitoring },
+    { SA_Kill, 0, AM_Idle }, { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } },
+  { "crash during GooB monitoring", false, GM_AfterStop, {
+    { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_GooBMonitoring }, { SA_Kill, 0, AM_Idle },
+    { SA_Launch, 0, AM_GooBMonitoring }, { SA_Wait, 0, AM_GooBRinging }, { SA_DoubleClick, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } },
+  { "wakeup lost before launch", false, GM_Off, {
+    { SA_LoseWakeups, 0, AM_Idle }, { SA_Launch, 0, AM_Idle }, { SA_Wait, 0, AM_Ringing },
+    { SA_DoubleClick, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "snooze lost before launch", false, GM_Off, {
+    { SA_Wait, 0, AM_Ringing }, { SA_Click, 0, AM_Snoozing }, { SA_Kill, 0, AM_Idle },
+    { SA_LoseWakeups, 0, AM_Idle }, { SA_Launch, 0, AM_Snoozing }, { SA_Wait, 0, AM_Ringing },
+    { SA_DoubleClick, 0, AM_Idle }, { SA_End, 0, AM_Idle } } },
+  { "worker confirmed", true, GM_AfterStop, {
+    { SA_AskWorker, 0, AM_Idle }, { SA_Wait, 0, AM_SmartMonitoring }, { SA_ConfirmWorker, 0, AM_SmartMonitoring },
+    { SA_Stirring, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_GooBMonitoring }, { SA_GooBStopped, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } },
+  { "monitoring lost before launch", true, GM_Off, {
+    { SA_Wait, 0, AM_SmartMonitoring }, { SA_Kill, 0, AM_Idle }, { SA_LoseWakeups, 0, AM_Idle },
+    { SA_Launch, 0, AM_SmartMonitoring }, { SA_Wait, 0, AM_Ringing }, { SA_DoubleClick, 0, AM_Idle },
+    { SA_End, 0, AM_Idle } } }
+};
+
+static const SimScript *s_script;
+static uint8_t s_night;
+// Flash reads an alarm launch did before its first vibration (the last one this night)
+static uint16_t s_reads_before_vibe;
+
+static void state_problem(const char *where, const char *problem) {
+  test_fail(__FILE__, __LINE__, "night %d, after %s: %s", s_night, where, problem);
+}
+
+// Checks a recorded wakeup is still scheduled with the wakeup service (and for the recorded time if given)
+static bool wakeup_scheduled(WakeupId id, time_t wakeup_time) {
+  time_t scheduled;
+  return id > 0 && wakeup_query(id, &scheduled) && (wakeup_time == 0 || scheduled == wakeup_time);
+}
+
+// Checks the alarm flags agree with each other and, once the wakeups have been set, that the
+// alarm and Get Out Of Bed wakeups the state relies on are actually scheduled
+static void check_state(const char *where, bool wakeups_set) {
+  if (s_alarm_active && s_goob_active)
+    state_problem(where, "alarm and GooB alarm both active");
+  if (s_state.snoozing && !s_alarm_active && !s_goob_active)
+    state_problem(where, "snoozing without an active alarm");
+  if (s_state.monitoring && (s_alarm_active || s_goob_active))
+    state_problem(where, "Smart Alarm monitoring while alarm active");
+
+  if (!wakeups_set || !s_alarms_on) return;
+
+  time_t curr_time = time(NULL);
+  if ((s_state.snoozing || s_state.monitoring || s_alarm_active || s_goob_active || s_next_alarm != NEXT_ALARM_NONE) &&
+      !wakeup_scheduled(s_wakeup_id, s_wakeup_time) && !wakeup_scheduled(s_wakeup_goob_id, 0))
+    state_problem(where, "no alarm wakeup scheduled");
+  if (s_state.goob_monitoring && s_goob_time > curr_time && !wakeup_scheduled(s_wakeup_goob_id, 0))
+    state_problem(where, "GooB wakeup lost");
+}
+
+// Puts everything the app keeps in memory back as it is when the app starts
+static void clear_memory() {
+  s_alarms_on = true;
+  memset(s_alarms, 0, sizeof(s_alarms));
+  s_info[0] = '\0';
+  s_info_alarm_time = 0;
+  s_info_day = 0;
+  s_wakeup_id = 0;
+  s_wakeup_goob_id = 0;
+  s_wakeup_time = 0;
+  s_runtime_seq = 0;
+  s_snooze_until = 0;
+  s_alarm_active = false;
+  s_goob_active = false;
+  s_goob_time = 0;
+  s_skip_until = 0;
+  s_vibe_count = 0;
+  s_last_easylight = 0;
+  s_accel_service_sub = false;
+  s_worker_monitoring = false;
+  s_next_alarm = NEXT_ALARM_NONE;
+  s_light_shown = false;
+  memset(&s_stirring, 0, sizeof(s_stirring));
+  s_loaded = false;
+  s_dst_check_started = false;
+  memset(&s_arm_swings, 0, sizeof(s_arm_swings));
+  s_vibe_timer = NULL;
+  memset(&s_settings, 0, sizeof(s_settings));
+  memset(&s_state, 0, sizeof(s_state));
+}
+
+// Each launch starts the app from scratch
+static void sim_init(void) {
+  clear_memory();
+  init();
+}
+
+// Does a script step, then checks the state once the wakeups have been set
+static void sim_step(const SimStep *step) {
+  switch (step->action) {
+    case SA_Wait: {
+      uint16_t launches = fake_counts().launches;
+      if (!fake_run(SIM_MAX_WAIT_MS, true)) state_problem("wait", "no wakeup");
+      // A launch for the alarm vibrates before it writes to flash, shows the main window or sets timers
+      if (fake_counts().launches > launches && (get_alarm_mode() == AM_Ringing || get_alarm_mode() == AM_GooBRinging)) {
+        FakeCounts before = fake_counts_before_vibe();
+        if (before.persist_writes || before.windows || before.timers)
+          state_problem("wait", "work done before the first vibration");
+        s_reads_before_vibe = before.persist_reads;
+      }
+      // A launch to start Smart Alarm monitoring that the worker takes never shows the main window
+      if (fake_counts().launches > launches && s_state.monitoring && fake_worker_running() &&
+          fake_counts_before_vibe().windows > 0)
+        state_problem("wait", "main window shown while the worker monitors");
+      break;
+    }
+    case SA_Run:
+      fake_run(step->minutes * 60 * 1000, false);
+      break;
+    case SA_Click:
+      fake_click(BUTTON_ID_SELECT);
+      break;
+    case SA_DoubleClick:
+      fake_double_click(BUTTON_ID_SELECT);
+      break;
+    case SA_Stirring:
+      fake_worker_event(WMT_Stirring);
+      break;
+    case SA_GooBStopped:
+      fake_worker_event(WMT_GooBStopped);
+      break;
+    case SA_Kill:
+      fake_kill();
+      return;
+    case SA_Launch:
+      fake_launch(APP_LAUNCH_USER, 0, 0);
+      break;
+    case SA_LoseWakeups:
+      wakeup_cancel_all();
+      break;
+    case SA_AskWorker:
+      fake_worker_ask_confirmation(true);
+      break;
+    case SA_ConfirmWorker:
+      fake_worker_confirm();
+      break;
+    default:
+      break;
+  }
+  // Let the delayed wakeup setting happen
+  fake_run(1000, false);
+  if (!fake_app_running()) return;
+
+  const char *where = s_action_names[step->action];
+  check_state(where, true);
+  if (fake_worker_running() && fake_accel_subscribed() &&
+      (get_alarm_mode() == AM_SmartMonitoring || get_alarm_mode() == AM_GooBMonitoring))
+    state_problem(where, "app and worker both monitoring");
+  if (s_alarms_on && fake_wakeup_count(ALARM_WAKEUP_REASONS) > 1)
+    state_problem(where, "more than one alarm wakeup pending");
+  if (get_alarm_mode() != step->mode) {
+    char problem[48];
+    snprintf(problem, sizeof(problem), "%s when expecting %s", s_mode_names[get_alarm_mode()],
+             s_mode_names[step->mode]);
+    state_problem(where, problem);
+  }
+}
+
+// Runs the script for each night, starting from a fresh install the evening before the first night
+// with a 07:00 alarm every day. Prints the counts for the last night (or every night with HOST_TEST_LOG)
+static void run_script(void) {
+  fake_reset();
+  fake_set_timezone("GMT0BST,M3.5.0/1,M10.5.0");
+  fake_set_time(fake_utc(2021, 6, 1, 21, 0));
+
+  alarm alarms[7];
+  for (uint8_t d = 0; d < 7; d++)
+    alarms[d] = (alarm){ .enabled = true, .hour = 7, .minute = 0 };
+  struct Settings_st settings = {
+    .snooze_delay = 9,
+    .smart_alarm = s_script->smart_alarm,
+    .monitor_period = 30,
+    .sensitivity = MS_MEDIUM,
+    .vibe_pattern = VP_Gentle,
+    .goob_mode = s_script->goob_mode,
+    .goob_monitor_period = 5
+  };
+  persist_write_data(ALARMS_KEY, alarms, sizeof(alarms));
+  persist_write_data(SETTINGS_KEY, &settings, sizeof(settings));
+
+  // The user sets the alarms and closes the app
+  fake_launch(APP_LAUNCH_USER, 0, 0);
+  fake_run(1000, false);
+  fake_exit();
+
+  for (s_night = 1; s_night <= SIM_NIGHTS; s_night++) {
+    fake_clear_counts();
+    s_reads_before_vibe = 0;
+    for (const SimStep *step = s_script->steps; step->action != SA_End; step++)
+      sim_step(step);
+    // The app is closed until the next night's wakeup
+    fake_exit();
+
+    FakeCounts counts = fake_counts();
+    if (s_night == SIM_NIGHTS || getenv("HOST_TEST_LOG"))
+      printf("  night %d: %d wakeups, %d launches, %d timers, %d flash writes, %d vibe segments, "
+             "%d flash reads before vibrating\n", s_night, counts.wakeups, counts.launches, counts.timers,
+             counts.persist_writes, counts.vibe_segments, s_reads_before_vibe);
+  }
+}
+
+int main(void) {
+  fake_set_app(sim_init, deinit);
+
+  for (uint8_t i = 0; i < ARRAY_LENGTH(s_scripts); i++) {
+    s_script = &s_scripts[i];
+    run_test(s_script->name, run_script);
+  }
+  return test_summary();
+}
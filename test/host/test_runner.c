@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include "test_runner.h"
+
+static const char *s_test_name;
+static bool s_test_failed;
+static int s_failures;
+
+void run_test(const char *name, void (*test)(void)) {
+  s_test_name = name;
+  s_test_failed = false;
+  test();
+  if (s_test_failed)
+    s_failures++;
+  else
+    printf("pass %s\n", name);
+}
+
+int test_summary(void) {
+  printf(s_failures ? "%d failed\n" : "All passed\n", s_failures);
+  return s_failures ? 1 : 0;
+}
+
+void test_fail(const char *file, int line, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  printf("FAIL %s: %s:%d ", s_test_name, file, line);
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+  s_test_failed = true;
+}
+
+static void format_utc(long long timestamp, char *str, size_t len) {
+  time_t t = timestamp;
+  struct tm tm;
+  if (t == 0)
+    snprintf(str, len, "0");
+  else
+    strftime(str, len, "%a %Y-%m-%d %H:%M UTC", gmtime_r(&t, &tm));
+}
+
+void check_time(const char *file, int line, const char *name, long long actual, long long expected) {
+  if (actual == expected) return;
+  char actual_str[32], expected_str[32];
+  format_utc(actual, actual_str, sizeof(actual_str));
+  format_utc(expected, expected_str, sizeof(expected_str));
+  test_fail(file, line, "%s is %s, expected %s", name, actual_str, expected_str);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdbool.h>
+
+// Minimal test runner for the host tests (reports like test/phoneconfig_test.js)
+
+// Runs a test, printing whether it passed
+void run_test(const char *name, void (*test)(void));
+// Prints the summary and gives the exit code for main
+int test_summary(void);
+// Fails the running test with a message (the test carries on, so all failures are reported)
+void test_fail(const char *file, int line, const char *fmt, ...);
+
+#define CHECK(cond) \
+  do { if (!(cond)) test_fail(__FILE__, __LINE__, "%s", #cond); } while (0)
+#define CHECK_EQ(actual, expected) \
+  do { long long a_ = (actual), e_ = (expected); \
+       if (a_ != e_) test_fail(__FILE__, __LINE__, "%s is %lld, expected %lld", #actual, a_, e_); } while (0)
+// Compares timestamps, showing them as UTC dates
+#define CHECK_TIME(actual, expected) check_time(__FILE__, __LINE__, #actual, actual, expected)
+void check_time(const char *file, int line, const char *name, long long actual, long long expected);
@@ -0,0 +1,62 @@
+// Checks the phone side config packing in src/js/app.js against the packed config test vectors
+// that the watch checks too (src/c/phoneconfig_vectors.h)
+// Run with: node test/phoneconfig_test.js
+
+var fs = require('fs');
+var path = require('path');
+var vm = require('vm');
+var assert = require('assert');
+
+var root = path.join(__dirname, '..');
+
+// Load app.js with a stand-in for the Pebble object
+var app = { Pebble: { addEventListener: function() {}, sendAppMessage: function() {}, openURL: function() {} },
+            console: console };
+vm.runInNewContext(fs.readFileSync(path.join(root, 'src/js/app.js'), 'utf8'), app);
+
+// Read the vectors from the C header
+var header = fs.readFileSync(path.join(root, 'src/c/phoneconfig_vectors.h'), 'utf8');
+var vectors = [];
+var re = /\{ "([^"]+)", (PCR_\w+), (\d+), \{ ([^}]*) \} \}/g;
+var match;
+while ((match = re.exec(header)) !== null) {
+  var data = match[4].split(',').map(function(hex) { return parseInt(hex, 16); });
+  assert.strictEqual(data.length, +match[3], match[1] + ': length does not match data');
+  vectors.push({ name: match[1], result: match[2], data: data });
+}
+assert.ok(vectors.length > 0, 'no vectors found');
+
+var failures = 0;
+function check(name, fn) {
+  try {
+    fn();
+    console.log('pass ' + name);
+  } catch (e) {
+    failures++;
+    console.log('FAIL ' + name + ': ' + e.message);
+  }
+}
+
+check('crc16 check value', function() {
+  var bytes = '123456789'.split('').map(function(c) { return c.charCodeAt(0); });
+  assert.strictEqual(app.crc16(bytes, bytes.length), 0x29B1);
+});
+
+vectors.forEach(function(vector) {
+  check(vector.name, function() {
+    var config = app.unpackConfig(vector.data);
+    if (vector.result === 'PCR_BAD_LENGTH' || vector.result === 'PCR_BAD_VERSION' ||
+        vector.result === 'PCR_BAD_CHECKSUM') {
+      // The phone rejects these before looking at the values
+      assert.strictEqual(config, null);
+    } else {
+      // Values are range checked by the watch, so the phone must pack them back exactly as received
+      assert.notStrictEqual(config, null);
+      // (copied into an array from this context, since app.js runs in its own)
+      assert.deepStrictEqual(Array.from(app.packConfig(config)), vector.data);
+    }
+  });
+});
+
+console.log(failures ? failures + ' failed' : 'All passed');
+process.exit(failures ? 1 : 0);
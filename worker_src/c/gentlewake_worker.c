@@ -0,0 +1,101 @@
+#include <pebble_worker.h>
+#include "../../src/c/workermsg.h"
+#include "../../src/c/movement.h"
+
+// Background worker that monitors movement for the Smart Alarm and the Get Out Of Bed alarm,
+// so the app only has to be running when the alarm has to ring
+
+static WorkerConfig s_config;
+static bool s_accel_service_sub;
+static StirringDetector s_stirring;
+static ArmSwingDetector s_arm_swings;
+
+// Sends a message to the app if it is running
+static void send_msg(WorkerMsgType type, uint16_t value) {
+  AppWorkerMessage msg = { .data0 = value };
+  app_worker_send_message(type, &msg);
+}
+
+// Tells the app about a detected event, launching it if it isn't running, and stops monitoring
+static void notify_app(WorkerMsgType type) {
+  stirring_save(&s_stirring);
+  persist_write_int(WORKER_EVENT_KEY, type);
+  send_msg(type, 0);
+  worker_launch_app();
+  
+  // Ignore any further movement until the app reconfigures or stops the worker
+  // (the accel service can't be unsubscribed from within its own callback)
+  s_config.mode = WM_None;
+}
+
+// Check for an accumulative amount of movement, which may indicate stirring
+static void check_stirring(AccelData *data, uint32_t num_samples) {
+  // (the peak movement for each epoch is saved for the alarm history as the epoch ends)
+  int movement = stirring_add(&s_stirring, data, num_samples);
+  
+  // If movement counter is over the threshold, the alarm needs to go off
+  if (movement > s_config.threshold) notify_app(WMT_Stirring);
+}
+
+// Monitor for movement that will cancel the Get Out Of Bed alarm
+static void check_arm_swings(AccelData *data, uint32_t num_samples) {
+  if (arm_swing_add(&s_arm_swings, data, num_samples) >= GOOB_ARM_SWINGS) notify_app(WMT_GooBStopped);
+}
+
+static void accel_handler(AccelData *data, uint32_t num_samples) {
+  switch (s_config.mode) {
+    case WM_Smart:
+      check_stirring(data, num_samples);
+      break;
+    case WM_GooB:
+      check_arm_swings(data, num_samples);
+      break;
+  }
+}
+
+// Loads the config saved by the app, resets the movement detection and starts or stops the
+// accelerometer for the mode
+static void apply_config() {
+  if (persist_read_data(WORKER_CONFIG_KEY, &s_config, sizeof(s_config)) != sizeof(s_config))
+    s_config.mode = WM_None;
+  
+  // Save the movement for the epoch so far before starting again
+  stirring_save(&s_stirring);
+  stirring_reset(&s_stirring, s_config.alarm_time);
+  arm_swing_reset(&s_arm_swings);
+  
+  if (s_config.mode != WM_None && !s_accel_service_sub) {
+    accel_data_service_subscribe(5, accel_handler);
+    accel_service_set_sampling_rate(ACCEL_SAMPLING_10HZ);
+    s_accel_service_sub = true;
+  } else if (s_config.mode == WM_None && s_accel_service_sub) {
+    accel_data_service_unsubscribe();
+    s_accel_service_sub = false;
+  }
+}
+
+static void app_message_handler(uint16_t type, AppWorkerMessage *data) {
+  if (type == WMT_Config) apply_config();
+}
+
+static void init(void) {
+  // The app saves what to monitor before launching the worker
+  apply_config();
+  
+  app_worker_message_subscribe(app_message_handler);
+  // Let the app know it can stop monitoring itself
+  if (s_config.mode != WM_None) send_msg(WMT_Monitoring, 0);
+}
+
+static void deinit(void) {
+  // Save the movement for the epoch so far when the app stops the worker
+  stirring_save(&s_stirring);
+  app_worker_message_unsubscribe();
+  if (s_accel_service_sub) accel_data_service_unsubscribe();
+}
+
+int main(void) {
+  init();
+  worker_event_loop();
+  deinit();
+}